@@ -0,0 +1,166 @@
+// Sample RFM69 session benchmark sketch, with Session Key library
+// Flash it on two nodes: one with BENCH_INITIATOR defined, the other without (responder).
+// The initiator measures sendWithSession -> interruptHook -> sendACK round trips for
+// each payload size up to SESSION_MAX_DATA_LEN and reports p50/p99 latency, goodput and
+// the time its last data frame took to be loaded in the FIFO, and the library RTT estimate.
+// The round trip is then broken down: p50 of the handshake wait (key request on air to key
+// received: key response air time plus the responder service latency, keyResponseLoadTime()
+// on the responder) and of the ACK wait (data frame on air to ACK received). The rest is the
+// carrier sense/backoff before the key request and the air time of the request and data frames.
+// The responder does not print anything while running, to keep its timing undisturbed.
+// extras/SessionBench runs this sketch on two simulated nodes on the host (no Moteino needed).
+
+#include <RFM69_SessionKey.h> // enable session key support extension for RFM69 base library
+#include <RFM69.h>            //get it here: https://www.github.com/lowpowerlab/rfm69
+#include <SPI.h>
+
+#ifndef BENCH_RESPONDER       // defined by the host build of the responder (extras/SessionBench)
+#define BENCH_INITIATOR       // comment out on the responder node
+#endif
+#ifdef BENCH_INITIATOR
+  #define NODEID      3       //unique for each node on same network
+  #define PEERID      1       //node running the responder
+#else
+  #define NODEID      1
+  #define PEERID      3
+#endif
+#define NETWORKID     110  //the same on all nodes that talk to each other
+//Match frequency to the hardware version of the radio on your Moteino (uncomment one):
+#define FREQUENCY     RF69_433MHZ
+//#define FREQUENCY     RF69_868MHZ
+//#define FREQUENCY     RF69_915MHZ
+#define ENCRYPTKEY    "sampleEncryptKey" //exactly the same 16 characters/bytes on all nodes!
+//#define MACKEY      "sampleMacKey0123" //uncomment on both nodes to measure the frames with a MAC (fifo(us) includes the sender tag)
+//#define IS_RFM69HW    //uncomment only for RFM69HW! Leave out if you have RFM69W!
+#define SERIAL_BAUD   115200
+#ifndef BENCH_SAMPLES
+#define BENCH_SAMPLES 50   // round trips measured per payload size
+#endif
+#ifndef BENCH_STEP
+#define BENCH_STEP    8    // payload size increment (bytes)
+#endif
+#ifndef BENCH_LOOP_MS
+#define BENCH_LOOP_MS 0    // responder: ms the sketch is busy between two receiveDone() calls (a slow gateway loop)
+#endif
+
+RFM69_SessionKey radio;       // create radio instance
+bool SESSION_3ACKS = false;   // set 3 acks at the end of a session transfer (or not)
+unsigned long SESSION_WAIT_TIME = 40; // adjust wait time of data recption in session mode (default is 40ms)
+uint8_t payload[SESSION_MAX_DATA_LEN];
+uint16_t latency[BENCH_SAMPLES];      // round trip times in units of 10us (up to 655ms)
+uint16_t handshake[BENCH_SAMPLES];    // handshake waits (us) of the round trips acknowledged
+uint16_t ackWait[BENCH_SAMPLES];      // ACK waits (us) of the round trips acknowledged
+uint32_t rxCount = 0;                 // responder: frames received
+
+void setup()
+{
+  Serial.begin(SERIAL_BAUD);
+  delay(10);
+  radio.initialize(FREQUENCY,NODEID,NETWORKID);
+#ifdef IS_RFM69HW
+  radio.setHighPower(); //only for RFM69HW!
+#endif
+  radio.encrypt(ENCRYPTKEY);            // set encryption
+#if defined(MACKEY) && SESSION_USE_MAC
+  radio.useSessionMac(MACKEY);          // authenticate the session frames
+#endif
+  radio.useSessionKey(true);            // set session mode
+  radio.sessionWaitTime(SESSION_WAIT_TIME);// set session wait time
+  radio.useSession3Acks(SESSION_3ACKS); // 3acks at session transfer end
+  for (uint8_t i = 0; i < sizeof(payload); i++)
+    payload[i] = 'A' + (i % 26);
+#ifdef BENCH_INITIATOR
+  Serial.println("\nSession benchmark initiator, press 'b' to run");
+#else
+  Serial.println("\nSession benchmark responder, press 's' for the received count");
+#endif
+}
+
+void loop()
+{
+  if (Serial.available() > 0)
+  {
+    char input = Serial.read();
+#ifdef BENCH_INITIATOR
+    if (input == 'b') runBenchmark();
+#else
+    if (input == 's')
+    {
+      Serial.print("Received: "); Serial.print(rxCount);
+      Serial.print("  key response FIFO loaded (us): "); Serial.print(radio.keyResponseLoadTime());
+      Serial.print("  longest ISR (us): "); Serial.println(radio.isrTime());
+    }
+#endif
+  }
+#ifndef BENCH_INITIATOR
+  if (BENCH_LOOP_MS > 0) delay(BENCH_LOOP_MS);
+  if (radio.receiveDone())
+  {
+    rxCount++;
+    if (radio.ACKRequested())
+      radio.sendACK();
+  }
+#endif
+}
+
+#ifdef BENCH_INITIATOR
+void runBenchmark()
+{
+  Serial.println("size  ok   p50(us)  p99(us)  goodput(B/s)  fifo(us)  srtt(us)  hs(us)  ack(us)");
+  for (uint8_t size = 0; ; size += BENCH_STEP)
+  {
+    if (size > SESSION_MAX_DATA_LEN) size = SESSION_MAX_DATA_LEN;
+    benchSize(size);
+    if (size == SESSION_MAX_DATA_LEN) break;
+  }
+}
+
+void benchSize(uint8_t size)
+{
+  uint8_t ok = 0;
+  uint32_t elapsed = 0;
+  for (uint8_t i = 0; i < BENCH_SAMPLES; i++)
+  {
+    uint32_t start = micros();
+    bool acked = radio.sendWithRetry(PEERID, payload, size, 0, SESSION_WAIT_TIME); // 0 = only 1 attempt, no retries
+    uint32_t rtt = micros() - start;
+    elapsed += rtt;
+    if (acked)
+    {
+      handshake[ok] = radio.handshakeTime();
+      ackWait[ok] = radio.ackTime();
+      latency[ok++] = rtt / 10 > 0xFFFF ? 0xFFFF : rtt / 10;
+    }
+    delay(5);                           // let the responder go back to RX
+  }
+  sortSamples(latency, ok);
+  sortSamples(handshake, ok);
+  sortSamples(ackWait, ok);
+  Serial.print(size); Serial.print("    ");
+  Serial.print(ok); Serial.print("   ");
+  Serial.print(ok ? (uint32_t)latency[percentile(ok, 50)] * 10 : 0); Serial.print("    ");
+  Serial.print(ok ? (uint32_t)latency[percentile(ok, 99)] * 10 : 0); Serial.print("    ");
+  Serial.print(elapsed ? (uint32_t)((uint64_t)ok * size * 1000000UL / elapsed) : 0); Serial.print("    ");
+  Serial.print(radio.fifoLoadTime()); Serial.print("    ");
+  Serial.print(radio.sessionRtt(PEERID)); Serial.print("    ");
+  Serial.print(ok ? handshake[percentile(ok, 50)] : 0); Serial.print("    ");
+  Serial.println(ok ? ackWait[percentile(ok, 50)] : 0);
+}
+
+void sortSamples(uint16_t* samples, uint8_t count)
+{
+  for (uint8_t i = 1; i < count; i++)   // insertion sort, BENCH_SAMPLES is small
+  {
+    uint16_t v = samples[i];
+    uint8_t j = i;
+    while (j > 0 && samples[j-1] > v) { samples[j] = samples[j-1]; j--; }
+    samples[j] = v;
+  }
+}
+
+uint8_t percentile(uint8_t count, uint8_t pct)
+{
+  uint16_t index = ((uint16_t)count * pct + 99) / 100;  // nearest-rank method
+  return index ? index - 1 : 0;
+}
+#endif
@@ -3,6 +3,7 @@
 #include <RFM69_SessionKey.h> // enable session key support extension for RFM69 base library
 #include <RFM69.h>            //get it here: https://www.github.com/lowpowerlab/rfm69
 #include <SPI.h>
+#include <EEPROM.h>
 
 #define NODEID        1    //unique for each node on same network
 #define NETWORKID     110  //the same on all nodes that talk to each other
@@ -11,8 +12,12 @@
 //#define FREQUENCY     RF69_868MHZ
 //#define FREQUENCY     RF69_915MHZ
 #define ENCRYPTKEY    "sampleEncryptKey" //exactly the same 16 characters/bytes on all nodes!
+#define MACKEY        "sampleMacKey0123" //MAC key of the session frames, exactly the same 16 characters/bytes on all nodes!
 //#define IS_RFM69HW    //uncomment only for RFM69HW! Leave out if you have RFM69W!
 #define SERIAL_BAUD   115200
+#define GROUP_EPOCH_ADDR 0 // EEPROM address of the next group broadcast epoch (0xFFFF: erased, none used yet)
+#define RESUME_ADDR   16   // EEPROM area of the resume tickets, written in turn to spread the wear
+#define RESUME_SIZE   512
 #ifdef __AVR_ATmega1284P__
   #define LED           15 // Moteino MEGA have LED on D15
   #define FLASH_SS      23 // and FLASH SS on D23
@@ -25,9 +30,24 @@ RFM69_SessionKey radio;       // create radio instance
 bool promiscuousMode = false; //set to 'true' to sniff all packets on the same network
 bool SESSION_KEY = true;      // set usage of session mode (or not)
 bool SESSION_3ACKS = false;   // set 3 acks at the end of a session transfer (or not)
+bool SESSION_NEXT_KEY = false; // piggy-back the next session key on the final ACK (or not), same value on all nodes
+uint8_t SESSION_BURST = 1;    // frames sent with one session key within 1s (1 = one key per frame), same value on all nodes
 unsigned long SESSION_WAIT_TIME = 40; // adjust wait time of data recption in session mode (default is 40ms)
 byte ackCount=0;              // use to count 
 uint32_t packetCount = 0;     // use to count the received packets
+#if SESSION_USE_RESUME
+SessionResume tickets[16];    // resume tickets given to the nodes, they skip the key request also after a restart
+
+void storeRead(uint16_t address, uint8_t* data, uint8_t length)
+{
+  for (uint8_t i = 0; i < length; i++) data[i] = EEPROM.read(address + i);
+}
+
+void storeWrite(uint16_t address, const uint8_t* data, uint8_t length)
+{
+  for (uint8_t i = 0; i < length; i++) EEPROM.update(address + i, data[i]);
+}
+#endif
 
 void setup()
 {
@@ -38,9 +58,29 @@ void setup()
   radio.setHighPower(); //only for RFM69HW!
 #endif
   radio.encrypt(ENCRYPTKEY);            // set encryption
+#if SESSION_USE_MAC
+  radio.useSessionMac(MACKEY);          // authenticate the session frames
+#endif
   radio.useSessionKey(SESSION_KEY);     // set session mode
   radio.promiscuous(promiscuousMode);   // set promiscuous mode
   radio.sessionWaitTime(40);            // adjust wait time of data recption in session mode (default is 40ms) 
+  radio.useSessionNextKey(SESSION_NEXT_KEY); // skip the key request when the previous ACK carried the next key
+  radio.sessionBurst(SESSION_BURST, 1000); // several frames per session key
+#if SESSION_USE_GROUP
+  uint16_t epoch;                       // group broadcasts: never reuse an epoch after a restart
+  EEPROM.get(GROUP_EPOCH_ADDR, epoch);
+  if (epoch == 0xFFFF) epoch = 0;       // erased EEPROM
+  if (epoch < 0xFFFE)                   // the next epoch stored must not read as erased: the epochs never wrap to 0
+  {
+    radio.useSessionGroup(NODEID, epoch, 2); // this gateway is the group master, 2 copies of each broadcast
+    EEPROM.put(GROUP_EPOCH_ADDR, (uint16_t)(epoch + 1));
+  }
+  else Serial.println("Group broadcast epochs used up, no group broadcast");
+#endif
+#if SESSION_USE_RESUME
+  if (radio.sessionResumeStore(tickets, 16, storeRead, storeWrite, RESUME_ADDR, RESUME_SIZE))
+    Serial.println("Resume tickets restored");
+#endif
   char buff[50];
   sprintf(buff, "\nListening at %d Mhz...", FREQUENCY==RF69_433MHZ ? 433 : FREQUENCY==RF69_868MHZ ? 868 : 915);
   Serial.println(buff);
@@ -61,8 +101,52 @@ void loop() {
       Serial.print(fTemp); //converting to F loses some resolution, obvious when C is on edge between 2 values (ie 26C=78F, 27C=80F)
       Serial.println('F');
     }
+#if SESSION_USE_GROUP
+    if (input == 'b') // send a group broadcast to all nodes
+    {
+      radio.send(RF69_BROADCAST_ADDR, "ALL OFF", 7);
+      Serial.print("Group broadcast sent, epoch "); Serial.println(radio.sessionGroupEpoch());
+    }
+#endif
+#if SESSION_USE_STATS
+    if (input == 's') // print the session statistics
+    {
+      SessionStats stats;
+      radio.sessionStats(&stats);
+      Serial.print("Handshakes started/completed/timeouts: ");
+      Serial.print(stats.handshakesStarted); Serial.print('/');
+      Serial.print(stats.handshakesCompleted); Serial.print('/');
+      Serial.println(stats.keyTimeouts);
+      Serial.print("Keys issued: "); Serial.print(stats.keysIssued);
+      Serial.print("  refused: "); Serial.print(stats.keysRefused);
+      Serial.print("  accepted: "); Serial.print(stats.framesAccepted);
+      Serial.print("  mismatches: "); Serial.println(stats.keyMismatches);
+      Serial.print("ACK timeouts: "); Serial.print(stats.ackTimeouts);
+      Serial.print("  ACK repeats: "); Serial.print(stats.ackRepeats);
+      Serial.print("  CSMA waits: "); Serial.print(stats.csmaWaits);
+      Serial.print("  peer evictions: "); Serial.println(stats.peerEvictions);
+      Serial.print("Handshake latency (<1ms, <2ms, ...):");
+      for (byte i = 0; i < SESSION_STATS_BUCKETS; i++)
+      {
+        Serial.print(' '); Serial.print(stats.latency[i]);
+      }
+      Serial.println();
+    }
+#endif
+#if SESSION_USE_TRACE
+    if (input == 'd') // dump the frame trace in binary, decode the serial capture with extras/SessionTrace
+    {
+      static uint8_t trace[SESSION_TRACE_HEADER + SESSION_TRACE_SIZE * SESSION_TRACE_ENTRY];
+      Serial.write(trace, radio.sessionTraceDump(trace, sizeof(trace)));
+      Serial.println();
+    }
+#endif
   }
 
+#if SESSION_USE_RESUME
+  radio.sessionResumeFlush(); // save the resume tickets given or running out, between two frames
+#endif
+
   if (radio.receiveDone())
   {
     Serial.print("#[");
@@ -73,6 +157,19 @@ void loop() {
     {
       Serial.print("to [");Serial.print(radio.TARGETID, DEC);Serial.print("] ");
     }
+#if SESSION_USE_RECORDS
+    if (radio.recordsReceived())
+    {
+      uint8_t type, length;
+      const uint8_t* data;
+      while (radio.nextRecord(&type, &data, &length)) // one frame of small records
+      {
+        Serial.print("{type "); Serial.print(type);
+        Serial.print(", "); Serial.print(length); Serial.print(" bytes} ");
+      }
+    }
+    else
+#endif
     for (byte i = 0; i < radio.DATALEN; i++)
       Serial.print((char)radio.DATA[i]);
     Serial.print("   [RX_RSSI:");Serial.print(radio.RSSI);Serial.print("]");
@@ -3,15 +3,18 @@
 #include <RFM69_SessionKey.h> // enable session key support extension for RFM69 base library
 #include <RFM69.h>    //get it here: https://www.github.com/lowpowerlab/rfm69
 #include <SPI.h>
+#include <EEPROM.h>
 
 #define NODEID        3    //unique for each node on same network
 #define NETWORKID     110  //the same on all nodes that talk to each other
 #define GATEWAYID     1
+#define GROUP_COUNTER_ADDR 0 // EEPROM address of the last group broadcast accepted (epoch/counter, 0xFFFFFFFF: erased)
 //Match frequency to the hardware version of the radio on your Moteino (uncomment one):
 #define FREQUENCY   RF69_433MHZ
 //#define FREQUENCY   RF69_868MHZ
 //#define FREQUENCY     RF69_915MHZ
 #define ENCRYPTKEY    "sampleEncryptKey" //exactly the same 16 characters/bytes on all nodes!
+#define MACKEY        "sampleMacKey0123" //MAC key of the session frames, exactly the same 16 characters/bytes on all nodes!
 //#define IS_RFM69HW    //uncomment only for RFM69HW! Leave out if you have RFM69W!
 #define SERIAL_BAUD   115200
 #ifdef __AVR_ATmega1284P__
@@ -31,6 +34,8 @@ RFM69_SessionKey radio;       // create radio instance
 bool promiscuousMode = false; //set to 'true' to sniff all packets on the same network
 bool SESSION_KEY = true;      // set usage of session mode (or not)
 bool SESSION_3ACKS = false;   // set 3 acks at the end of a session transfer (or not)
+bool SESSION_NEXT_KEY = false; // piggy-back the next session key on the final ACK (or not), same value on all nodes
+uint8_t SESSION_BURST = 1;    // frames sent with one session key within 1s (1 = one key per frame), same value on all nodes
 unsigned long SESSION_WAIT_TIME = 40; // adjust wait time of data recption in session mode (default is 40ms)
 void setup() {
   Serial.begin(SERIAL_BAUD);
@@ -39,10 +44,24 @@ void setup() {
   radio.setHighPower(); //uncomment only for RFM69HW!
 #endif
   radio.encrypt(ENCRYPTKEY);            // set encryption
+#if SESSION_USE_MAC
+  radio.useSessionMac(MACKEY);          // authenticate the session frames
+#endif
   radio.useSessionKey(SESSION_KEY);     // set session mode
   radio.promiscuous(promiscuousMode);   // set promiscuous mode
   radio.sessionWaitTime(SESSION_WAIT_TIME);// set session wait time
   radio.useSession3Acks(SESSION_3ACKS); // 3acks at session transfer end
+  radio.useSessionNextKey(SESSION_NEXT_KEY); // skip the key request when the previous ACK carried the next key
+  radio.sessionBurst(SESSION_BURST, 1000); // several frames per session key
+#if SESSION_USE_GROUP
+  uint32_t groupCounter;                // the group broadcasts accepted before a restart stay refused
+  EEPROM.get(GROUP_COUNTER_ADDR, groupCounter);
+  if (groupCounter == 0xFFFFFFFF) groupCounter = 0; // erased EEPROM
+  radio.useSessionGroup(GATEWAYID, groupCounter >> 16, 1, groupCounter); // accept the group broadcasts of the gateway
+#endif
+#if SESSION_USE_RESUME
+  radio.useSessionResume(true);         // skip the key requests with a resume ticket of the gateway
+#endif
   char buff[50];
   sprintf(buff, "\nTransmitting at %d Mhz...", FREQUENCY==RF69_433MHZ ? 433 : FREQUENCY==RF69_868MHZ ? 868 : 915);
   Serial.println(buff);
@@ -58,6 +77,10 @@ void loop()
     for (byte i = 0; i < radio.DATALEN; i++)
       Serial.print((char)radio.DATA[i]);
     Serial.print("   [RX_RSSI:");Serial.print(radio.RSSI);Serial.print("]");
+#if SESSION_USE_GROUP
+    if (radio.TARGETID == RF69_BROADCAST_ADDR) // a group broadcast: keep its counter (1 or 2 EEPROM bytes written each)
+      EEPROM.put(GROUP_COUNTER_ADDR, (uint32_t)radio.sessionGroupCounter());
+#endif
 
     if (radio.ACKRequested())
     {
@@ -25,6 +25,7 @@
 //  12. Correct typo in RFM69_SessionKey::initialise instead of RFM69_SessionKey::initialize
 //  13. Improve messages of 9.
 //	14. Correct restore Interrupt in receiveDone() function for ESP8266 compatibilities 
+//  15 and later: see RFM69_SessionKey.h
 // **********************************************************************************
 // Session key class derived from RFM69 library. Session key prevents replay of wireless transmissions.
 // **********************************************************************************
@@ -61,22 +62,164 @@
 #include <RFM69registers.h>
 #include <SPI.h>
 
+#if SESSION_USE_STATS
+#define SESSION_STAT(counter)	_stats.counter++								// !RVDB count an event in the statistics
+#else
+#define SESSION_STAT(counter)	((void)0)										// !RVDB still a statement: no empty if/else body
+#endif
+
+#if SESSION_USE_TRACE
+#define SESSION_TRACE(event, ctl, peer, key, status, time) trace(event, ctl, peer, key, status, time) // !RVDB record an event in the trace ring
+#define SESSION_TRACE_RESULT(status, key) (_traceStatus = status, _traceKey = key) // !RVDB outcome of the frame being received
+#else
+#define SESSION_TRACE(event, ctl, peer, key, status, time) ((void)0)
+#define SESSION_TRACE_RESULT(status, key) ((void)0)
+#endif
+
+#if SESSION_USE_RESUME
+#define SESSION_RESUME_FLAGS	(_resumeSent ? SESSION_CTL_GROUP : 0)			// !RVDB CTL flag of the frame sent again with its resume key
+#define SESSION_TICKET_FLAGS	(_resumeEnabled && _macEnabled && _resumePeer == RF69_BROADCAST_ADDR ? SESSION_CTL_GROUP : 0) // !RVDB key request asking for a resume ticket
+#else
+#define SESSION_RESUME_FLAGS	0
+#define SESSION_TICKET_FLAGS	0
+#endif
+
 volatile uint8_t RFM69_SessionKey::SESSION_KEY_INCLUDED; // flag in CTL byte indicating this packet includes a session key
 volatile uint8_t RFM69_SessionKey::SESSION_KEY_REQUESTED; // flag in CTL byte indicating this packet is a request for a session key
 volatile uint8_t RFM69_SessionKey::SESSION_KEY_RCV_STATUS;		    //***** !RVDB add a variable to indicate the type the session key status after receive was done
 
-volatile unsigned long RFM69_SessionKey::SESSION_KEY; // !RVDB set to the session key value for a particular transmission
-volatile uint8_t RFM69_SessionKey::SESSION_KEY1; // !RVDB set to the session key High value for a particular transmission
-volatile uint8_t RFM69_SessionKey::SESSION_KEY2; // !RVDB set to the session key Medium value for a particular transmission
-volatile uint8_t RFM69_SessionKey::SESSION_KEY3; // !RVDB set to the session key Medium value for a particular transmission
-volatile uint8_t RFM69_SessionKey::SESSION_KEY4; // !RVDB set to the session key Low value for a particular transmission
-volatile unsigned long RFM69_SessionKey::INCOMING_SESSION_KEY; // !RVDB set on an incoming packet and used to decide if receiveDone should be true and data should be processed
-volatile uint8_t RFM69_SessionKey::INCOMING_SESSION_KEY1; // !RVDB set to the session key High value for a particular transmission
-volatile uint8_t RFM69_SessionKey::INCOMING_SESSION_KEY2; // !RVDB set to the session key Medium value for a particular transmission
-volatile uint8_t RFM69_SessionKey::INCOMING_SESSION_KEY3; // !RVDB set to the session key Medium value for a particular transmission
-volatile uint8_t RFM69_SessionKey::INCOMING_SESSION_KEY4; // !RVDB set to the session key Low value for a particular transmission
+volatile unsigned long RFM69_SessionKey::SESSION_KEY; // !RVDB set to the session key received from SESSION_KEY_PEER for our own transmission
+volatile uint8_t RFM69_SessionKey::SESSION_KEY_PEER; // !RVDB set to the node the session key was requested from
+volatile unsigned long RFM69_SessionKey::SESSION_BASE_KEY; // !RVDB set to the base key of the burst session with SESSION_KEY_PEER
+volatile uint8_t RFM69_SessionKey::SESSION_COUNTER; // !RVDB set to the counter of the next frame of the burst session
+volatile unsigned long RFM69_SessionKey::SESSION_EXPIRES; // !RVDB millis() time at which the burst session ends
+volatile uint8_t RFM69_SessionKey::SESSION_ACK_PENDING; // !RVDB set while the ACK of the last session frame sent is awaited
+volatile unsigned long RFM69_SessionKey::INCOMING_SESSION_KEY; // !RVDB set on an incoming packet, echoed back in the ACK
+volatile uint8_t RFM69_SessionKey::SESSION_KEY_ACCEPTED; // !RVDB set when the incoming packet carries the expected session key
+volatile uint8_t RFM69_SessionKey::SESSION_STREAM_FRAME; // !RVDB set when the incoming packet is a stream fragment or its selective ACK
+volatile unsigned long RFM69_SessionKey::SESSION_NEXT_KEY; // !RVDB key of the next session, piggy-backed on the last ACK of SESSION_NEXT_KEY_PEER
+volatile uint8_t RFM69_SessionKey::SESSION_NEXT_KEY_PEER; // !RVDB set to the node SESSION_NEXT_KEY was received from
+volatile unsigned long RFM69_SessionKey::SESSION_NEXT_KEY_EXPIRES; // !RVDB millis() time after which SESSION_NEXT_KEY is considered stale
+volatile SessionPeer RFM69_SessionKey::_peers[SESSION_PEER_TABLE_SIZE]; // !RVDB session keys issued to the remote nodes
+#if SESSION_USE_STREAM
+volatile SessionStream RFM69_SessionKey::_stream; // !RVDB stream being received
+#endif
 volatile uint16_t RFM69_SessionKey::_waitTime; 	  // !RVDB used to store the retryWaitTime (ms) for multiple ACK Send loop
 volatile uint16_t RFM69_SessionKey::_respDelayTime; 	  // !RVDB used to store the Session KEY challenge response for slow remote nodes
+volatile unsigned long RFM69_SessionKey::_nextKeyTime; 	  // !RVDB used to store the validity time (ms) of a piggy-backed next session key
+volatile uint8_t RFM69_SessionKey::_burstFrames; 	  // !RVDB used to store the maximum number of frames sent with one session key
+volatile uint16_t RFM69_SessionKey::_burstTime; 	  // !RVDB used to store the maximum duration (ms) of a burst session
+uint32_t RFM69_SessionKey::_txStart; 	  // !RVDB millis() time the frame being transmitted was started
+#if SESSION_USE_ASYNC_SEND
+uint8_t RFM69_SessionKey::_sendState; 	  // !RVDB state of the non-blocking send (SESSION_SEND_xxx)
+uint8_t RFM69_SessionKey::_sendTo; 	  // !RVDB destination of the non-blocking send
+uint8_t RFM69_SessionKey::_sendData[SESSION_MAX_DATA_LEN]; // !RVDB payload of the non-blocking send
+uint8_t RFM69_SessionKey::_sendSize; 	  // !RVDB payload size of the non-blocking send
+bool RFM69_SessionKey::_sendRequestACK; // !RVDB set if the non-blocking send requests an ACK
+uint8_t RFM69_SessionKey::_sendRetries; // !RVDB retries left for the non-blocking send
+uint8_t RFM69_SessionKey::_sendResend; // !RVDB 1: the next attempt sends the frame again with its key, 2: the last attempt did
+uint32_t RFM69_SessionKey::_sendTime; 	  // !RVDB millis() time the current state of the non-blocking send was entered
+SessionSendCallback RFM69_SessionKey::_sendDone; // !RVDB called when the non-blocking send is over
+bool RFM69_SessionKey::_sendBusy; 	  // !RVDB set once the non-blocking send found the channel busy
+uint32_t RFM69_SessionKey::_rttStart; // !RVDB micros() time the frame waiting for an answer in poll() was sent
+uint32_t RFM69_SessionKey::_sendWake; // !RVDB millis() time the backoff of the non-blocking send ends
+uint8_t RFM69_SessionKey::_sendExponent; // !RVDB backoff window of the non-blocking send (2^n slots)
+#endif
+#if SESSION_USE_TX_QUEUE
+SessionTxFrame* RFM69_SessionKey::_txQueue; // !RVDB send queue slots (NULL when the queue is not used)
+uint8_t RFM69_SessionKey::_txDepth; 	  // !RVDB number of send queue slots
+uint8_t RFM69_SessionKey::_txCount; 	  // !RVDB frames in the send queue, oldest first
+#endif
+#if SESSION_USE_ZERO_COPY
+uint8_t* RFM69_SessionKey::_rxBuffer; // !RVDB payload destination of the interrupt handler (NULL to use DATA)
+uint8_t RFM69_SessionKey::_rxSize; 	  // !RVDB size of the payload destination
+volatile uint8_t RFM69_SessionKey::_rxLength; // !RVDB payload bytes stored in the payload destination
+SessionReceiveCallback RFM69_SessionKey::_rxCallback; // !RVDB called by receiveDone() with the payload received
+#endif
+#if SESSION_USE_MAC
+SessionMac RFM69_SessionKey::_mac; // !RVDB MAC key schedule, done once by useSessionMac()
+bool RFM69_SessionKey::_macEnabled; // !RVDB set when the frames with a session key carry a MAC
+volatile uint8_t RFM69_SessionKey::_macLength; // !RVDB payload bytes already read into DATA by macCheck(), restored by interruptHandler()
+uint8_t RFM69_SessionKey::_macFirst; // !RVDB DATA[0], overwritten by the base class interrupt handler
+#endif
+#if SESSION_USE_RECORDS
+volatile uint8_t RFM69_SessionKey::SESSION_RECORDS_FRAME; // !RVDB set when the incoming packet is a payload of records
+uint8_t RFM69_SessionKey::_recordOffset; // !RVDB next record returned by nextRecord()
+SessionRecordBuffer* RFM69_SessionKey::_records; // !RVDB record buffers (NULL when records are not used)
+uint8_t RFM69_SessionKey::_recordCount; // !RVDB number of record buffers
+uint16_t RFM69_SessionKey::_recordDeadline; // !RVDB ms a record waits at most before flushRecords() sends it
+uint8_t RFM69_SessionKey::_recordRetries; // !RVDB sendWithRetry() retries of a record frame
+#endif
+uint8_t RFM69_SessionKey::_backoffSlot; // !RVDB backoff slot (ms), 0 without backoff
+uint8_t RFM69_SessionKey::_backoffMax; // !RVDB largest backoff window (2^n slots)
+uint32_t RFM69_SessionKey::_backoffSeed; // !RVDB state of the backoff random generator
+uint32_t RFM69_SessionKey::_keySeed; // !RVDB state of the session key random generator
+volatile uint16_t RFM69_SessionKey::_fifoLoadTime; // !RVDB us taken by the last startFrame() to load the FIFO
+volatile uint16_t RFM69_SessionKey::_keyResponseLoadTime; // !RVDB us from the key request in interruptHook() to the key response loaded in the FIFO
+uint16_t RFM69_SessionKey::_handshakeTime; // !RVDB us from the last key request sent to its session key received
+uint16_t RFM69_SessionKey::_ackTime; // !RVDB us from the last frame sent to its ACK received
+volatile SessionRtt RFM69_SessionKey::_rtt[SESSION_PEER_TABLE_SIZE]; // !RVDB round trip time estimates of the remote nodes
+volatile uint8_t RFM69_SessionKey::_rttNext; // !RVDB next _rtt entry replaced by a new node
+#if SESSION_USE_STATS
+volatile SessionStats RFM69_SessionKey::_stats; // !RVDB statistics
+#endif
+#if SESSION_USE_TRACE
+volatile SessionTraceEntry RFM69_SessionKey::_trace[SESSION_TRACE_SIZE]; // !RVDB trace ring
+volatile uint16_t RFM69_SessionKey::_traceCount; // !RVDB events recorded, the last SESSION_TRACE_SIZE ones are kept
+bool RFM69_SessionKey::_traceEnabled; // !RVDB set while the events are recorded
+volatile uint8_t RFM69_SessionKey::_traceCTL; // !RVDB CTL byte, status and key of the frame being received
+volatile uint8_t RFM69_SessionKey::_traceStatus;
+volatile unsigned long RFM69_SessionKey::_traceKey;
+#endif
+#if SESSION_USE_RX_QUEUE
+volatile uint8_t RFM69_SessionKey::_lastCTL; // !RVDB CTL byte of the last frame received
+SessionFrame* RFM69_SessionKey::_queue; // !RVDB receive queue slots (NULL when the queue is not used)
+uint8_t RFM69_SessionKey::_queueDepth; // !RVDB number of receive queue slots
+volatile uint8_t RFM69_SessionKey::_queueHead; // !RVDB oldest frame of the receive queue
+volatile uint8_t RFM69_SessionKey::_queueCount; // !RVDB frames in the receive queue
+volatile uint32_t RFM69_SessionKey::_queueDrops; // !RVDB frames dropped because the receive queue was full
+#endif
+volatile SessionReply RFM69_SessionKey::_replies[SESSION_REPLY_QUEUE_SIZE]; // !RVDB session key responses to send
+volatile uint8_t RFM69_SessionKey::_replyHead; // !RVDB oldest session key response
+volatile uint8_t RFM69_SessionKey::_replyCount; // !RVDB session key responses to send
+volatile bool RFM69_SessionKey::_replySending; // !RVDB set while a queued frame is sent, the interrupt handler ends it
+bool RFM69_SessionKey::_replyKeep; // !RVDB set when a frame not read yet by receiveDone() is kept meanwhile
+volatile uint16_t RFM69_SessionKey::_isrTime; // !RVDB longest interrupt handler duration (us) since the last isrTime()
+#if SESSION_USE_GROUP
+uint8_t RFM69_SessionKey::_groupMaster; // !RVDB node sending the group broadcasts, RF69_BROADCAST_ADDR when none
+uint8_t RFM69_SessionKey::_groupRepeats; // !RVDB copies of each group broadcast sent by the master
+volatile unsigned long RFM69_SessionKey::_groupCounter; // !RVDB epoch (high 16 bits) and counter of the last group broadcast sent or accepted
+#endif
+#if SESSION_USE_RESUME
+bool RFM69_SessionKey::_resumeEnabled; // !RVDB set when the frames to the node that gave our resume ticket use it
+volatile uint8_t RFM69_SessionKey::_resumePeer; // !RVDB node that gave our resume ticket, RF69_BROADCAST_ADDR when none
+volatile unsigned long RFM69_SessionKey::_resumeKey; // !RVDB resume key of the last frame sent with the ticket
+volatile uint8_t RFM69_SessionKey::_resumeSent; // !RVDB set when the last session frame sent used the resume ticket
+volatile uint8_t RFM69_SessionKey::_resumeResync; // !RVDB set by the resync answer to that frame
+volatile uint8_t RFM69_SessionKey::_resumeLeapt; // !RVDB set once the counter leapt after a failed send, until an ACK
+volatile uint8_t RFM69_SessionKey::_resumeFailures; // !RVDB failed sends since the last acknowledged resume frame
+SessionResume* RFM69_SessionKey::_resumes; // !RVDB resume tickets given to the remote nodes (NULL when none is given)
+uint8_t RFM69_SessionKey::_resumeCount; // !RVDB number of resume tickets
+uint8_t RFM69_SessionKey::_resumeEpoch; // !RVDB epoch of the resume tickets given
+volatile uint8_t RFM69_SessionKey::_resumeDirty; // !RVDB set when a reservation must be saved by sessionResumeFlush()
+SessionStoreRead RFM69_SessionKey::_storeRead; // !RVDB resume table store
+SessionStoreWrite RFM69_SessionKey::_storeWrite;
+uint16_t RFM69_SessionKey::_storeAddress; // !RVDB address of the first store slot
+uint8_t RFM69_SessionKey::_storeSlots; // !RVDB number of store slots, written in turn
+uint8_t RFM69_SessionKey::_storeSlot; // !RVDB slot of the last resume table saved
+uint8_t RFM69_SessionKey::_storeSeq; // !RVDB sequence number of the last resume table saved
+#endif
+#if SESSION_USE_RESUME && SESSION_USE_ASYNC_SEND
+bool RFM69_SessionKey::_sendResynced; // !RVDB set once the non-blocking send got a resync answer
+#endif
+//=============================================================================
+//  ! RVDB New function
+//  SESSION_CONFIG() - Its name encodes the compile time options the library was built with,
+//                     the constructor compiled in the sketch calls the one of its own options
+//=============================================================================
+void SESSION_CONFIG() {
+}
+
 //=============================================================================
 // initialize() - Some extra initialisation before calling base class
 //=============================================================================
@@ -84,10 +227,87 @@ bool RFM69_SessionKey::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t netw
 {
   _sessionKeyEnabled = false; 							// default to disabled
   _session3AcksEnabled = false; 						// !RVDB initialise the 3 final Acks Options
+  _sessionNextKeyEnabled = false;						// !RVDB initialise the next session key Option
   SESSION_KEY_INCLUDED = 0;
   SESSION_KEY_REQUESTED = 0;
   _waitTime = 40;										// !RVDB initialise the default watchdog time between Session Request and Session Included
   _respDelayTime = 0;									// !RVDB initialise the Session KEY response delay 
+  _nextKeyTime = 300000;								// !RVDB initialise the next session key validity time (5 minutes)
+  _burstFrames = 1;										// !RVDB initialise one frame per session key (no burst)
+  _burstTime = 1000;
+  SESSION_KEY = 0;
+  SESSION_BASE_KEY = 0;
+  SESSION_NEXT_KEY = 0;
+  for (uint8_t i = 0; i < SESSION_PEER_TABLE_SIZE; i++)	// !RVDB no round trip time known
+    _rtt[i].nodeID = RF69_BROADCAST_ADDR;
+  _rttNext = 0;
+#if SESSION_USE_STATS
+  memset((void*)&_stats, 0, sizeof(SessionStats));		// !RVDB statistics start at 0
+#endif
+#if SESSION_USE_TRACE
+  _traceCount = 0;										// !RVDB empty trace ring, recording
+  _traceStatus = 0;
+  _traceEnabled = true;
+#endif
+#if SESSION_USE_RX_QUEUE
+  _queue = NULL;										// !RVDB no receive queue
+  _queueDepth = 0;
+  _queueHead = 0;
+  _queueCount = 0;
+  _queueDrops = 0;
+#endif
+  _replyHead = 0;										// !RVDB no session key response to send
+  _replyCount = 0;
+  _replySending = false;
+  _isrTime = 0;
+  for (uint8_t i = 0; i < SESSION_PEER_TABLE_SIZE; i++)	// !RVDB no session in progress with any peer
+    _peers[i].key = 0;
+#if SESSION_USE_STREAM
+  _stream.state = 0;									// !RVDB no stream in progress, streams refused until receiveStream()
+  _stream.key = 0;
+  _stream.buffer = NULL;
+#endif
+#if SESSION_USE_ASYNC_SEND
+  _sendState = SESSION_SEND_IDLE;
+#endif
+#if SESSION_USE_TX_QUEUE
+  _txQueue = NULL;										// !RVDB no send queue
+  _txDepth = 0;
+  _txCount = 0;
+#endif
+#if SESSION_USE_ZERO_COPY
+  _rxBuffer = NULL;										// !RVDB payload received in DATA
+  _rxSize = 0;
+  _rxLength = 0;
+  _rxCallback = NULL;
+#endif
+#if SESSION_USE_MAC
+  _macEnabled = false;									// !RVDB no MAC until useSessionMac()
+  _macLength = 0;
+#endif
+#if SESSION_USE_RECORDS
+  SESSION_RECORDS_FRAME = 0;
+  _records = NULL;										// !RVDB records not used
+  _recordCount = 0;
+#endif
+  _backoffSlot = SESSION_BACKOFF_SLOT;
+  _backoffMax = SESSION_BACKOFF_MAX;
+  _backoffSeed = ((uint32_t)nodeID << 24) ^ ((uint32_t)networkID << 16) ^ micros(); // !RVDB differs between nodes with the same firmware
+  _keySeed = ~_backoffSeed;								// !RVDB its own generator, used with interrupts off
+#if SESSION_USE_GROUP
+  _groupMaster = RF69_BROADCAST_ADDR;					// !RVDB group broadcasts refused until useSessionGroup()
+  _groupRepeats = 1;
+  _groupCounter = 0;
+#endif
+#if SESSION_USE_RESUME
+  _resumeEnabled = false;								// !RVDB no resume ticket used nor given until useSessionResume(), sessionResumeStore()
+  _resumePeer = RF69_BROADCAST_ADDR;
+  _resumeSent = 0;
+  _resumeResync = 0;
+  _resumes = NULL;
+  _resumeCount = 0;
+  _resumeDirty = 0;
+#endif
   return RFM69::initialize(freqBand, nodeID, networkID);// use base class to initialise everything else
 }
 
@@ -97,72 +317,403 @@ bool RFM69_SessionKey::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t netw
 //=============================================================================
 void RFM69_SessionKey::send(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK)
 { 
-  // !RVDB Do not Send Session Data to the Broadcast node ID)
-  if (toAddress == RF69_BROADCAST_ADDR) return; 
+  // !RVDB Do not Send Session Data to the Broadcast node ID), except a group broadcast of the group master
+  if (toAddress == RF69_BROADCAST_ADDR)
+  {
+#if SESSION_USE_GROUP
+    if (sessionKeyEnabled() && _groupMaster == _address) sendGroup(buffer, bufferSize);
+#endif
+    return;
+  }
+  sendFlagged(toAddress, buffer, bufferSize, requestACK, 0);
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  sendFlagged() - Body of send() to a node, sessionFlags (SESSION_CTL_MASK) are set in the CTL byte
+//=============================================================================
+void RFM69_SessionKey::sendFlagged(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, uint8_t sessionFlags)
+{
   writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
-  uint32_t now = millis();
-  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
+  waitCanSend();
   if (sessionKeyEnabled())
   {
-    sendWithSession(toAddress, buffer, bufferSize, requestACK, _waitTime); // !RVDB add the _waitTime parameter
+    sendWithSession(toAddress, buffer, bufferSize, requestACK, _waitTime, sessionFlags); // !RVDB add the _waitTime parameter
 
   }
   else
   {
-    sendFrame(toAddress, buffer, bufferSize, requestACK, false);
+    sendFrame(toAddress, buffer, bufferSize, requestACK, false, false, false, 0, sessionFlags);
   }  
 }
 
+//=============================================================================
+//  ! RVDB New function
+//  sendWithRetry() - Same as the base class, but each ACK wait is the timeout derived from
+//                    the round trip time estimate of toAddress (retryWaitTime is its upper
+//                    bound), and a session frame that could not get its key is not waited for
+//=============================================================================
+bool RFM69_SessionKey::sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries, uint8_t retryWaitTime) {
+  return retrySend(toAddress, buffer, bufferSize, retries, retryWaitTime, 0);
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  retrySend() - Body of sendWithRetry(), sessionFlags (SESSION_CTL_MASK) are set in the CTL byte
+//=============================================================================
+bool RFM69_SessionKey::retrySend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries, uint8_t retryWaitTime, uint8_t sessionFlags) {
+  uint8_t resend = 0;									// !RVDB as _sendResend
+#if SESSION_USE_RESUME
+  bool resynced = false;								// !RVDB set once a resync answer was received
+#endif
+  for (uint8_t i = 0; i <= retries; i++)
+  {
+    if (i > 0) backoffWait(resend == 1 ? i + 1 : i);	// !RVDB the nodes that collided don't retry together (the data frame is longer)
+    if (resend == 1)
+    {
+      // !RVDB the frame or its ACK was lost: send the frame again with its key, before a new key request
+      resendFrame(toAddress, buffer, bufferSize, sessionFlags);
+      resend = 2;
+    }
+    else if (sessionFlags) sendFlagged(toAddress, buffer, bufferSize, true, sessionFlags);
+    else send(toAddress, buffer, bufferSize, true);
+    if (sessionKeyEnabled() && SESSION_KEY == 0) continue;	// no session key, nothing was sent
+    uint16_t waitTime = sessionTimeout(toAddress, retryWaitTime);
+    uint32_t sentTime = millis();
+    uint32_t sentMicros = micros();
+    while (millis() - sentTime < waitTime)
+    {
+      if (ACKReceived(toAddress))
+      {
+        countAck(toAddress, micros() - sentMicros);
+        return true;
+      }
+#if SESSION_USE_RESUME
+      if (_resumeResync) break;							// !RVDB resume frame refused, no ACK will come
+#endif
+    }
+#if SESSION_USE_RESUME
+    if (_resumeResync)
+    {
+      // !RVDB the next attempt uses the counter given by the resync answer (or requests a key and a new ticket),
+      // the first resync is not counted as an attempt
+      _resumeResync = 0;
+      resend = 0;
+      if (!resynced) i--;
+      resynced = true;
+      continue;
+    }
+#endif
+    rttTimeout(toAddress);
+    SESSION_STAT(ackTimeouts);
+    SESSION_TRACE(SESSION_TRACE_TIMEOUT, 0, toAddress, SESSION_KEY, SESSION_SEND_ACK_WAIT, micros());
+    resend = sessionKeyEnabled() && resend == 0 ? 1 : 0;
+  }
+#if SESSION_USE_RESUME
+  resumeFailed();
+#endif
+  return false;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  resendFrame() - Send the last session frame again with its key (SESSION_KEY), after its ACK
+//                  timed out. If the frame was lost, the key is still valid at the receiver for
+//                  4 x sessionWaitTime; if its ACK was lost, the receiver sends the ACK again
+//                  and does not give the frame twice to its sketch (repeatAck)
+//=============================================================================
+void RFM69_SessionKey::resendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t sessionFlags) {
+  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+  waitCanSend();
+  SESSION_ACK_PENDING = 1;
+  sendFrame(toAddress, buffer, bufferSize, true, false, false, true, SESSION_KEY, sessionFlags | SESSION_RESUME_FLAGS);
+}
+
 //=============================================================================
 // sendWithSession() - Function to do the heavy lifting of session handling so it is transparent to sketch
 //=============================================================================
-void RFM69_SessionKey::sendWithSession(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, uint16_t retryWaitTime) {
+void RFM69_SessionKey::sendWithSession(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, uint16_t retryWaitTime, uint8_t sessionFlags) {
 //    Serial.print("\n\r Send with Session; Request ACK is: "), Serial.print(requestACK), Serial.print(" Wait Time is: "), Serial.println (retryWaitTime);
+  // !RVDB use the burst session or piggy-backed key if any, else the resume ticket, else request a new key
+  if (!cachedSessionKey(toAddress))
+  {
+#if SESSION_USE_RESUME
+    if (resumeKey(toAddress)) sessionFlags |= SESSION_CTL_GROUP;
+    else
+#endif
+    {
+      if (!requestSessionKey(toAddress, retryWaitTime, SESSION_TICKET_FLAGS)) return;
+      startSession();
+    }
+  }
+//  Serial.print("Request ACK: ");Serial.println(requestACK); Serial.println(SESSION_KEY);
+  // finally send the data! request the ACK if needed
+  SESSION_ACK_PENDING = requestACK;
+  sendFrame(toAddress, buffer, bufferSize, requestACK, false, false, true, SESSION_KEY, sessionFlags);
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  cachedSessionKey() - Get the key of the next frame to toAddress without requesting it:
+//                       continue the burst session with this node while it has frames left,
+//                       is not expired and its last frame was acknowledged (if requested),
+//                       else use the key piggy-backed on the previous ACK of this node.
+//                       Returns false when a session key must be requested
+//=============================================================================
+bool RFM69_SessionKey::cachedSessionKey(uint8_t toAddress) {
+#if SESSION_USE_RESUME
+  _resumeSent = 0;										// !RVDB a new frame, set again by resumeKey()
+  _resumeResync = 0;
+#endif
+  if (_burstFrames > 1 && SESSION_BASE_KEY != 0 && SESSION_KEY_PEER == toAddress && !SESSION_ACK_PENDING &&
+      SESSION_COUNTER < _burstFrames && (long)(SESSION_EXPIRES - millis()) >= 0)
+  {
+    SESSION_KEY = SESSION_BASE_KEY + SESSION_COUNTER++;	// the frame key is the base key plus the frame counter
+    SESSION_KEY_RCV_STATUS = 2;  // !RVDB Sender: the session key is computed
+    return true;
+  }
   // reset session key to blank value to start
   SESSION_KEY = 0;
+  SESSION_BASE_KEY = 0;
+  SESSION_KEY_PEER = toAddress;						// !RVDB only accept a session key from the node we are talking to
+  // !RVDB use the key piggy-backed on the previous ACK of this node if still fresh (used once)
+  // If the receiver doesn't know it anymore, no ACK comes back and the retry does a full key request
+  if (sessionNextKeyEnabled())
+  {
+    noInterrupts();
+    if (SESSION_NEXT_KEY != 0 && SESSION_NEXT_KEY_PEER == toAddress && (long)(SESSION_NEXT_KEY_EXPIRES - millis()) >= 0)
+      SESSION_KEY = SESSION_NEXT_KEY;
+    SESSION_NEXT_KEY = 0;
+    interrupts();
+    if (SESSION_KEY != 0)
+      SESSION_KEY_RCV_STATUS = 2;  // !RVDB Sender: the session key was received (on the previous ACK)
+  }
+  if (SESSION_KEY == 0) return false;
+  startSession();
+  return true;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  startSession() - The key just received is the base key of a new (burst) session,
+//                   used by its first frame
+//=============================================================================
+void RFM69_SessionKey::startSession() {
+  SESSION_BASE_KEY = SESSION_KEY;
+  SESSION_COUNTER = 1;
+  SESSION_EXPIRES = millis() + _burstTime;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  requestSessionKey() - Request a session key from toAddress and wait for it in SESSION_KEY.
+//                        Returns false when no key was received within retryWaitTime
+//=============================================================================
+bool RFM69_SessionKey::requestSessionKey(uint8_t toAddress, uint16_t retryWaitTime, uint8_t sessionFlags) {
+  SESSION_KEY = 0;
+  SESSION_KEY_PEER = toAddress;
   // start the session by requesting a key. don't request an ACK - ACKs are handled at the whole session level
   //Serial.println("sendWithSession: Requesting session key.");
-  sendFrame(toAddress, null, 0, false, false, true, false);
+  sendFrame(toAddress, null, 0, false, false, true, false, 0, sessionFlags);
+  SESSION_STAT(handshakesStarted);
   receiveBegin();
   // loop until session key received, or timeout
+  // !RVDB the timeout comes from the round trip time estimate of this node, retryWaitTime is its upper bound
+  retryWaitTime = sessionTimeout(toAddress, retryWaitTime);
   uint32_t sentTime = millis();
-  while ((millis() - sentTime) < retryWaitTime && SESSION_KEY == 0);
+  uint32_t sentMicros = micros();
+  while ((millis() - sentTime) < retryWaitTime && SESSION_KEY == 0) sessionService(); // !RVDB answer the requests meanwhile
+  if (SESSION_KEY != 0) countHandshake(toAddress, micros() - sentMicros);
   if (SESSION_KEY == 0) 
   {
+    countKeyTimeout(toAddress);
     SESSION_KEY_RCV_STATUS = 4;  // !RVDB Receiver: No Data received or Data without Session Key received
   // Serial.println("sendWithSession: SESSION_KEY = 0");
-    return;
+    return false;
   }
 //  Serial.print("Session Data after Time: "); Serial.println (millis()-sentTime); Serial.print("sendWithSession: Received key: ");
-//  Serial.print("Request ACK: ");Serial.println(requestACK); Serial.println(SESSION_KEY);
-  // finally send the data! request the ACK if needed
-  sendFrame(toAddress, buffer, bufferSize, requestACK, false, false, true);
+  return true;
+}
+
+#if SESSION_USE_GROUP
+//=============================================================================
+//  ! RVDB New function
+//  sendGroup() - Send buffer once to all nodes, without session key request nor ACK. The key
+//                bytes carry the next epoch/counter of the group master, the copies (useSessionGroup
+//                repeats) carry the same one and are refused by the nodes that got the first one.
+//                Nothing is sent once the 65535 counters of the epoch are used: the next epoch is
+//                the one of the next start, its broadcasts would be refused then
+//=============================================================================
+void RFM69_SessionKey::sendGroup(const void* buffer, uint8_t bufferSize) {
+  if ((uint16_t)_groupCounter == 0xFFFF) return;
+  unsigned long counter = ++_groupCounter;
+  for (uint8_t i = 0; i < _groupRepeats; i++)
+  {
+    if (i > 0) waitCanSend();
+    sendFrame(RF69_BROADCAST_ADDR, buffer, bufferSize, false, false, false, true, counter, SESSION_CTL_GROUP);
+  }
+  receiveBegin();
 }
+#endif
+
+#if SESSION_USE_STREAM
+//=============================================================================
+//  ! RVDB New function
+//  sendStream() - Send a buffer of any size to toAddress as fragments of SESSION_STREAM_DATA_LEN
+//                 bytes, all under one session key. Up to window fragments (max 32) are sent
+//                 before the last one asks for a selective ACK of the fragments received,
+//                 so only lost fragments are sent again. Returns true once all are acknowledged
+//=============================================================================
+bool RFM69_SessionKey::sendStream(uint8_t toAddress, const void* buffer, uint16_t bufferSize, uint8_t window, uint8_t retries) {
+  if (!sessionKeyEnabled() || toAddress == RF69_BROADCAST_ADDR) return false;
+  if (bufferSize == 0) return true;
+  if (window == 0) window = 1;
+  if (window > 32) window = 32;
+  uint16_t count = (bufferSize + SESSION_STREAM_DATA_LEN - 1) / SESSION_STREAM_DATA_LEN;
+  SESSION_BASE_KEY = 0;									// no burst session to continue after the stream
+  if (!requestSessionKey(toAddress, _waitTime, SESSION_CTL_STREAM)) return false;
+  unsigned long key = SESSION_KEY;
+  uint16_t counter = 0;									// frame counter, one per fragment sent
+  uint16_t acked = 0;									// first fragment not acknowledged
+  uint32_t done = 0;									// fragments acknowledged after acked
+  uint8_t failures = 0;
+  uint8_t frame[SESSION_MAX_DATA_LEN];
+  frame[2] = bufferSize >> 8;
+  frame[3] = bufferSize;
+  while (acked < count)
+  {
+    // find the last fragment of the window still to be sent, it will request the selective ACK
+    int8_t last = -1;
+    for (int8_t i = window - 1; i >= 0 && last < 0; i--)
+      if (acked + i < count && !(done & (1UL << i))) last = i;
+    waitCanSend();
+    for (int8_t i = 0; i <= last; i++)
+    {
+      uint16_t index = acked + i;
+      if (done & (1UL << i)) continue;
+      uint16_t offset = index * SESSION_STREAM_DATA_LEN;
+      uint8_t size = bufferSize - offset < SESSION_STREAM_DATA_LEN ? bufferSize - offset : SESSION_STREAM_DATA_LEN;
+      frame[0] = index >> 8;
+      frame[1] = index;
+      memcpy(frame + SESSION_STREAM_HEADER_LENGTH, (const uint8_t*)buffer + offset, size);
+      if (counter == 0xFFFF) return false;				// out of frame counters for this key
+      SESSION_KEY = key + counter++;
+      sendFrame(toAddress, frame, size + SESSION_STREAM_HEADER_LENGTH, i == last, false, false, true, SESSION_KEY, SESSION_CTL_STREAM);
+    }
+    // wait for the selective ACK: first fragment missing, then one bit per following fragment received
+    bool acknowledged = false;
+    uint16_t waitTime = sessionTimeout(toAddress, _waitTime);
+    uint32_t sentTime = millis();
+    uint32_t sentMicros = micros();
+    while (millis() - sentTime < waitTime && !acknowledged)
+    {
+      if (receiveDone() && SENDERID == toAddress && ACK_RECEIVED && SESSION_STREAM_FRAME && DATALEN >= 6)
+      {
+        uint16_t base = (uint16_t)DATA[0] << 8 | DATA[1];
+        if (base >= acked && base <= count)
+        {
+          done = (uint32_t)DATA[2] << 24 | (uint32_t)DATA[3] << 16 | (uint32_t)DATA[4] << 8 | DATA[5];
+          acked = base;
+          acknowledged = true;
+        }
+      }
+    }
+    if (acknowledged)
+    {
+      countAck(toAddress, micros() - sentMicros);
+      failures = 0;
+    }
+    else
+    {
+      rttTimeout(toAddress);
+      SESSION_STAT(ackTimeouts);
+      SESSION_TRACE(SESSION_TRACE_TIMEOUT, 0, toAddress, SESSION_KEY, SESSION_SEND_ACK_WAIT, micros());
+      if (++failures > retries) return false;
+    }
+  }
+  return true;
+}
+#endif
 
 //=============================================================================
 // sendAck() - Updated to call new sendFrame with additional parameters.
 //             Should be called immediately after reception in case sender wants ACK
 //=============================================================================
 void RFM69_SessionKey::sendACK(const void* buffer, uint8_t bufferSize) {
-  uint8_t sender = SENDERID;
-  uint8_t receiver = TARGETID;										// !RVDB Save the recipient node address
+  // !RVDB Save the sender, the recipient node address and the key of the acknowledged frame (echoed in the ACK)
+  sendACKTo(SENDERID, TARGETID, INCOMING_SESSION_KEY, buffer, bufferSize);
+}
+
+#if SESSION_USE_RX_QUEUE
+//=============================================================================
+//  ! RVDB New function
+//  sendQueuedACK() - Send the ACK of a frame taken from the receive queue
+//=============================================================================
+void RFM69_SessionKey::sendQueuedACK(const SessionFrame* frame, const void* buffer, uint8_t bufferSize) {
+  sendACKTo(frame->senderID, frame->targetID, frame->key, buffer, bufferSize);
+}
+#endif
+
+//=============================================================================
+//  ! RVDB New function
+//  sendACKTo() - Body of sendACK(), for the frame received from sender with key
+//=============================================================================
+void RFM69_SessionKey::sendACKTo(uint8_t sender, uint8_t receiver, unsigned long key, const void* buffer, uint8_t bufferSize) {
   int16_t _RSSI = RSSI; // save payload received RSSI value
   writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
-  uint32_t now = millis();
-  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
+  waitCanSend(false);									// !RVDB an ACK does not back off, the sender is waiting for it
   // if session keying is enabled, call sendFrame to include the session key
   // otherwise send as the built in library would
   // !RVDB Send 3 consecutive ACK to ensure the message both sender and recipient synchronisation (case of one ACK answer was lost)
   if (sessionKeyEnabled())
   {
-  	int acks = 3;
-  	if (!session3AcksEnabled()) acks = 1; 								// !RVDB adapt the final Acks according the the 3Acks enable value 
+    // !RVDB piggy-back the key of the next session with this node on the ACK (ACK payload starts with it)
+    // once its current (burst) session is over
+    bool nextKey = false;
+    unsigned long next = 0;
+    uint8_t ackData[SESSION_MAX_DATA_LEN];
+    if (sessionNextKeyEnabled())
+    {
+      noInterrupts();
+      if (findPeer(sender) == NULL) next = issueKey(sender, _nextKeyTime, true);	// 0 if no entry is free for it
+      nextKey = next != 0;
+      interrupts();
+    }
+    if (nextKey)
+    {
+      if (bufferSize > SESSION_MAX_DATA_LEN - SESSION_KEY_LENGTH) bufferSize = SESSION_MAX_DATA_LEN - SESSION_KEY_LENGTH;
+      ackData[0] = next>>24;
+      ackData[1] = next>>16;
+      ackData[2] = next>>8;
+      ackData[3] = next;
+      memcpy(ackData + SESSION_KEY_LENGTH, buffer, bufferSize);
+      buffer = ackData;
+      bufferSize += SESSION_KEY_LENGTH;
+    }
+    // !RVDB keep the key of the ACK, to send it again if the sender repeats the frame (its ACK was lost)
+    noInterrupts();
+    volatile SessionRtt* entry = findRtt(sender, true);
+    entry->ackedKey = key;
+    entry->ackedTime = millis();
+#if SESSION_USE_3ACKS
+    // !RVDB the extra ACK copies only go to a node whose ACKs were lost lately, one copy less every SESSION_ACK_DECAY ACKs
+  	int acks = session3AcksEnabled() ? 1 + entry->ackCopies : 1;		// !RVDB adapt the final Acks according the the 3Acks enable value
+    if (++entry->ackClean >= SESSION_ACK_DECAY)
+    {
+      if (entry->ackCopies > 0) entry->ackCopies--;
+      entry->ackClean = 0;
+    }
+#else
+  	const int acks = 1;
+#endif
+    interrupts();
      for (int i = 0; i <acks; i++) 
      {
        SENDERID = sender;          										// !RVDB Restore the sender ID (cleared after each sendAck message)
        TARGETID = receiver;             								// !RVDB Restore the target ID (cleared after each sendAck message
-       sendFrame(sender, buffer, bufferSize, false, true, false, true);  
-       delay (_waitTime/4);   											// !RVDB Ensure that total transmit time is less than the receiver ACK window time         									         
+       sendFrame(sender, buffer, bufferSize, false, true, nextKey, true, key);
+       if (i > 0) SESSION_STAT(ackRepeats);
+       if (i + 1 < acks) delay (sessionTimeout(sender, _waitTime)/4);	// !RVDB Ensure that total transmit time is less than the receiver ACK window time         									         
      }
   }
   else
@@ -184,17 +735,37 @@ void RFM69_SessionKey::sendFrame(uint8_t toAddress, const void* buffer, uint8_t
 //=============================================================================
 // sendFrame() - New with additional parameters. Handles the CTLbyte bits needed for session key
 //=============================================================================
-void RFM69_SessionKey::sendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK, bool sessionRequested, bool sessionIncluded)
+void RFM69_SessionKey::sendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK, bool sessionRequested, bool sessionIncluded, unsigned long sessionKey, uint8_t sessionFlags)
+{
+  startFrame(toAddress, buffer, bufferSize, requestACK, sendACK, sessionRequested, sessionIncluded, sessionKey, sessionFlags);
+  while (!frameSent()); // wait for DIO0 to turn HIGH signalling transmission finish
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  startFrame() - First part of sendFrame(): fill the FIFO and start the transmission
+//=============================================================================
+void RFM69_SessionKey::startFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK, bool sessionRequested, bool sessionIncluded, unsigned long sessionKey, uint8_t sessionFlags)
  {
 //  Serial.print("\n\r Send Frame; Request ACK is: "), Serial.print(requestACK);Serial.print (" - Send ACK is: "); Serial.print (sendACK); Serial.print (" - Session RQST is: "); Serial.print (sessionRequested);Serial.print (" - Session INC: "); Serial.println (sessionIncluded);
+  // !RVDB a queued frame started by the interrupt handler goes first, it turns the receiver on again once sent
+  while (_replySending && _mode == RF69_MODE_TX && millis() - _txStart < RF69_TX_LIMIT_MS);
+  uint32_t loadStart = micros();
   setMode(RF69_MODE_STANDBY); // turn off receiver to prevent reception while filling fifo
+  _replySending = false;								// !RVDB the radio is ours now (a queued frame cut by a mode change is lost)
   while ((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
   writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_00); // DIO0 is "Packet Sent"
   // !RVDB Correct the buffer size length according to the session Header
   if (bufferSize > SESSION_MAX_DATA_LEN) bufferSize = SESSION_MAX_DATA_LEN;
   
   // start with blank control byte
-  uint8_t CTLbyte = 0x00;
+  uint8_t CTLbyte = sessionFlags;						// !RVDB session flags of this library (SESSION_CTL_MASK)
+#if SESSION_USE_MAC
+  bool mac = sessionIncluded && _macEnabled;			// !RVDB every frame with a session key is authenticated
+  if (mac) CTLbyte = CTLbyte | SESSION_CTL_MAC;
+#else
+  const bool mac = false;
+#endif
   // layer on the bits to the CTLbyte as needed
   if (sendACK)
   {
@@ -216,134 +787,1515 @@ void RFM69_SessionKey::sendFrame(uint8_t toAddress, const void* buffer, uint8_t
     CTLbyte = CTLbyte | RFM69_CTL_EXT2;
    //Serial.println("Sendframe: Session included");
   } 
-    // write to FIFO
-  select();
-  SPI.transfer(REG_FIFO | 0x80);
+  // !RVDB build the whole FIFO write (register, header, session key, payload) in one buffer
+  // and clock it out with a single block transfer instead of one SPI.transfer() per byte
+  uint8_t frame[1 + SESSION_HEADER_LENGTH + SESSION_MAX_DATA_LEN + SESSION_MAC_LENGTH];
+  uint8_t length = 0;
+  frame[length++] = REG_FIFO | 0x80;
   if (sessionIncluded)
-    SPI.transfer(bufferSize + SESSION_HEADER_LENGTH-1); // !RVDB use Session Header definition
+    frame[length++] = bufferSize + SESSION_HEADER_LENGTH-1 + (mac ? SESSION_MAC_LENGTH : 0); // !RVDB use Session Header definition
   else
-  SPI.transfer(bufferSize + RF69_HEADER_LENGTH-1); 	    // !RVDB use RF69 header definition
-  SPI.transfer(toAddress);
-  SPI.transfer(_address);
-  SPI.transfer(CTLbyte);
+    frame[length++] = bufferSize + RF69_HEADER_LENGTH-1; 	// !RVDB use RF69 header definition
+  frame[length++] = toAddress;
+  frame[length++] = _address;
+  frame[length++] = CTLbyte;
   if (sessionIncluded)
   {
-    delayMicroseconds (_respDelayTime);			   		// !RVDB used to delayed transmission after a session request for slow remote node
-    SPI.transfer(SESSION_KEY1);							// !RVDB Session Key Higher Byte
-    SPI.transfer(SESSION_KEY2);							// !RVDB Session Key Medium Byte
-    SPI.transfer(SESSION_KEY3);							// !RVDB Session Key Medium Byte
-    SPI.transfer(SESSION_KEY4);							// !RVDB Session Key Lower Byte
-  } 
-   for (uint8_t i = 0; i < bufferSize; i++)
-  { 
-    SPI.transfer(((uint8_t*) buffer)[i]);
-  } 
+#if SESSION_USE_RESP_DELAY
+    delayMicroseconds (respDelay(toAddress));			// !RVDB used to delayed transmission after a session request for slow remote node
+#endif
+    frame[length++] = sessionKey>>24;					// !RVDB Session Key Higher Byte
+    frame[length++] = sessionKey>>16;					// !RVDB Session Key Medium Byte
+    frame[length++] = sessionKey>>8;					// !RVDB Session Key Medium Byte
+    frame[length++] = sessionKey;						// !RVDB Session Key Lower Byte
+  }
+  if (bufferSize > 0)
+  {
+    memcpy(frame + length, buffer, bufferSize);
+    length += bufferSize;
+  }
+#if SESSION_USE_MAC
+  if (mac)
+  {
+    // !RVDB MAC of everything after the FIFO register: length, header, session key and payload
+    uint32_t tag = _mac.tag(frame + 1, length - 1);
+    frame[length++] = tag;
+    frame[length++] = tag>>8;
+    frame[length++] = tag>>16;
+    frame[length++] = tag>>24;
+  }
+#endif
+  // write to FIFO
+  select();
+  SPI.transfer(frame, length);							// !RVDB the received bytes overwrite frame, it is not used anymore
   unselect();
+  _fifoLoadTime = micros() - loadStart;
+  SESSION_TRACE(SESSION_TRACE_TX, CTLbyte, toAddress, sessionIncluded ? sessionKey : 0, bufferSize, loadStart);
   // no need to wait for transmit mode to be ready since its handled by the radio
   setMode(RF69_MODE_TX);
-  uint32_t txStart = millis();
-  while (digitalRead(_interruptPin) == 0 && millis() - txStart < RF69_TX_LIMIT_MS); // wait for DIO0 to turn HIGH signalling transmission finish
+  _txStart = millis();
+ }
+
+//=============================================================================
+//  ! RVDB New function
+//  frameSent() - Second part of sendFrame(): true once DIO0 signals the end of the transmission
+//                started by startFrame() (or after RF69_TX_LIMIT_MS), the radio is then in standby
+//=============================================================================
+bool RFM69_SessionKey::frameSent()
+{
+  if (digitalRead(_interruptPin) == 0 && millis() - _txStart < RF69_TX_LIMIT_MS) return false;
   //while (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PACKETSENT == 0x00); // wait for ModeReady
   setMode(RF69_MODE_STANDBY);
- }
+  return true;
+}
+
+#if SESSION_USE_ASYNC_SEND
+//=============================================================================
+//  ! RVDB New function
+//  beginSend() - Start a non-blocking send of buffer to toAddress, with a session if enabled.
+//                poll() must then be called until sendStatus() is SESSION_SEND_OK or
+//                SESSION_SEND_FAILED. Returns false if a non-blocking send is already in progress
+//=============================================================================
+bool RFM69_SessionKey::beginSend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, uint8_t retries)
+{
+  if (toAddress == RF69_BROADCAST_ADDR) return false;
+  if (_sendState != SESSION_SEND_IDLE && _sendState != SESSION_SEND_OK && _sendState != SESSION_SEND_FAILED) return false;
+  if (bufferSize > SESSION_MAX_DATA_LEN) bufferSize = SESSION_MAX_DATA_LEN;
+  memcpy(_sendData, buffer, bufferSize);
+  _sendTo = toAddress;
+  _sendSize = bufferSize;
+  _sendRequestACK = requestACK;
+  _sendRetries = retries;
+  _sendResend = 0;
+#if SESSION_USE_RESUME
+  _sendResynced = false;
+#endif
+  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+  _sendState = SESSION_SEND_CSMA;
+  _sendTime = millis();
+  _sendWake = _sendTime;
+  _sendExponent = 0;
+  _sendBusy = false;
+  return true;
+}
+#endif
+
+#if SESSION_USE_ASYNC_SEND
+//=============================================================================
+//  ! RVDB New function
+//  poll() - Advance the non-blocking send, never waits. Returns sendStatus()
+//=============================================================================
+uint8_t RFM69_SessionKey::poll()
+{
+  if (serviceStep()) return _sendState;					// !RVDB the key responses go first, a poll() call per step
+#if SESSION_USE_TX_QUEUE
+  if (_txCount > 0 && (_sendState == SESSION_SEND_IDLE || _sendState == SESSION_SEND_OK || _sendState == SESSION_SEND_FAILED))
+  {
+    // !RVDB start the oldest frame of the highest priority
+    uint8_t next = 0;
+    for (uint8_t i = 1; i < _txCount; i++)
+      if (_txQueue[i].priority < _txQueue[next].priority) next = i;
+    SessionTxFrame* frame = &_txQueue[next];
+    beginSend(frame->toAddress, frame->data, frame->length, frame->requestACK, frame->retries);
+    _txCount--;
+    memmove(frame, frame + 1, (_txCount - next) * sizeof(SessionTxFrame));
+  }
+#endif
+  switch (_sendState)
+  {
+    case SESSION_SEND_CSMA:
+      if ((long)(millis() - _sendWake) < 0) break;		// !RVDB backing off
+      if (_mode != RF69_MODE_RX) receiveBegin();		// canSend() needs the receiver on (a received frame is left to the sketch)
+      if (!canSend() && millis() - _sendTime < RF69_CSMA_LIMIT_MS)
+      {
+        if (!_sendBusy && _sendExponent == 0) SESSION_STAT(csmaWaits);
+        _sendBusy = true;
+        break;
+      }
+      if (_sendBusy && _backoffSlot != 0 && millis() - _sendTime < RF69_CSMA_LIMIT_MS)
+      {
+        // !RVDB the channel just became free: back off before using it, within a window doubled
+        // each time, so the nodes waiting for the same frame to end don't all start together
+        receiveBegin();									// canSend() put the radio in standby
+        _sendBusy = false;
+        if (_sendExponent < _backoffMax) _sendExponent++;
+        _sendWake = millis() + backoffTime(_sendExponent);
+        break;
+      }
+      if (!sessionKeyEnabled())
+      {
+        startFrame(_sendTo, _sendData, _sendSize, _sendRequestACK, false, false, false);
+        _sendState = SESSION_SEND_DATA;
+      }
+      else if (_sendResend == 1)
+      {
+        // !RVDB the frame or its ACK was lost: send the frame again with its key, before a new key request
+        SESSION_ACK_PENDING = 1;
+        startFrame(_sendTo, _sendData, _sendSize, true, false, false, true, SESSION_KEY, SESSION_RESUME_FLAGS);
+        _sendResend = 2;
+        _sendState = SESSION_SEND_DATA;
+      }
+#if SESSION_USE_RESUME
+      else if (cachedSessionKey(_sendTo) || resumeKey(_sendTo))
+#else
+      else if (cachedSessionKey(_sendTo))
+#endif
+      {
+        SESSION_ACK_PENDING = _sendRequestACK;
+        startFrame(_sendTo, _sendData, _sendSize, _sendRequestACK, false, false, true, SESSION_KEY, SESSION_RESUME_FLAGS);
+        _sendState = SESSION_SEND_DATA;
+      }
+      else
+      {
+        SESSION_KEY = 0;
+        SESSION_KEY_PEER = _sendTo;
+        startFrame(_sendTo, null, 0, false, false, true, false, 0, SESSION_TICKET_FLAGS);
+        SESSION_STAT(handshakesStarted);
+        _sendState = SESSION_SEND_KEY_REQUEST;
+      }
+      break;
+    case SESSION_SEND_KEY_REQUEST:
+      if (!frameSent()) break;
+      receiveBegin();
+      _sendState = SESSION_SEND_KEY_WAIT;
+      _sendTime = millis();
+      _rttStart = micros();
+      break;
+    case SESSION_SEND_KEY_WAIT:
+      if (SESSION_KEY != 0)
+      {
+        countHandshake(_sendTo, micros() - _rttStart);
+        startSession();
+        SESSION_ACK_PENDING = _sendRequestACK;
+        startFrame(_sendTo, _sendData, _sendSize, _sendRequestACK, false, false, true, SESSION_KEY);
+        _sendState = SESSION_SEND_DATA;
+      }
+      else if (millis() - _sendTime >= sessionTimeout(_sendTo, _waitTime))
+      {
+        countKeyTimeout(_sendTo);
+        SESSION_KEY_RCV_STATUS = 4;  // !RVDB Receiver: No Data received or Data without Session Key received
+        endSend(SESSION_SEND_FAILED);
+      }
+      break;
+    case SESSION_SEND_DATA:
+      if (!frameSent()) break;
+      if (!_sendRequestACK)
+      {
+        endSend(SESSION_SEND_OK);
+        break;
+      }
+      receiveBegin();
+      _sendState = SESSION_SEND_ACK_WAIT;
+      _sendTime = millis();
+      _rttStart = micros();
+      break;
+    case SESSION_SEND_ACK_WAIT:
+      // the session ACK is checked by interruptHook(), a plain ACK only needs the ACK bit
+      if (sessionKeyEnabled() ? !SESSION_ACK_PENDING : (_mode == RF69_MODE_RX && PAYLOADLEN > 0 && ACK_RECEIVED && SENDERID == _sendTo))
+      {
+        if (_mode == RF69_MODE_RX && PAYLOADLEN > 0 && ACK_RECEIVED) receiveBegin(); // the ACK is not for the sketch
+        countAck(_sendTo, micros() - _rttStart);
+        endSend(SESSION_SEND_OK);
+      }
+#if SESSION_USE_RESUME
+      else if (_resumeResync)
+      {
+        // !RVDB resume frame refused: the next attempt uses the counter given by the resync answer,
+        // the first resync is not counted as an attempt
+        _resumeResync = 0;
+        _sendResend = 0;
+        if (!_sendResynced && _sendRetries < 0xFF) _sendRetries++;
+        _sendResynced = true;
+        endSend(SESSION_SEND_FAILED);
+      }
+#endif
+      else if (millis() - _sendTime >= sessionTimeout(_sendTo, _waitTime))
+      {
+        rttTimeout(_sendTo);
+        SESSION_STAT(ackTimeouts);
+        SESSION_TRACE(SESSION_TRACE_TIMEOUT, 0, _sendTo, SESSION_KEY, SESSION_SEND_ACK_WAIT, micros());
+        _sendResend = sessionKeyEnabled() && _sendResend == 0 ? 1 : 0;
+        endSend(SESSION_SEND_FAILED);
+      }
+      break;
+  }
+  return _sendState;
+}
+#endif
+
+#if SESSION_USE_ASYNC_SEND
+//=============================================================================
+//  ! RVDB New function
+//  endSend() - End the non-blocking send, or start its next retry
+//=============================================================================
+void RFM69_SessionKey::endSend(uint8_t status)
+{
+  if (status == SESSION_SEND_FAILED && _sendRetries > 0)
+  {
+    _sendRetries--;
+    _sendState = SESSION_SEND_CSMA;
+    _sendTime = millis();
+    if (_sendExponent < _backoffMax) _sendExponent++;
+    if (_sendResend == 1 && _sendExponent < _backoffMax) _sendExponent++;	// !RVDB the data frame is longer than a key request
+    _sendWake = _sendTime + backoffTime(_sendExponent);	// !RVDB the nodes that collided don't retry together
+    _sendBusy = false;
+    return;
+  }
+#if SESSION_USE_RESUME
+  if (status == SESSION_SEND_FAILED) resumeFailed();
+#endif
+  _sendState = status;
+  if (_sendDone) _sendDone(_sendTo, status);
+}
+#endif
 
 //=============================================================================
 // interruptHook() - Gets called by the base class interruptHandler right after the header is fetched
 //=============================================================================
 void RFM69_SessionKey::interruptHook(uint8_t CTLbyte) {
+  uint32_t hookStart = micros();
+#if SESSION_USE_RX_QUEUE
+  _lastCTL = CTLbyte;
+#endif
+#if SESSION_USE_TRACE
+  _traceCTL = CTLbyte;
+  SESSION_TRACE_RESULT(SESSION_TRACE_PLAIN, 0);
+#endif
   SESSION_KEY_REQUESTED = CTLbyte & RFM69_CTL_EXT1; // extract session key request flag
   SESSION_KEY_INCLUDED = CTLbyte & RFM69_CTL_EXT2; //extract session key included flag
+  SESSION_KEY_ACCEPTED = 0;
+  SESSION_STREAM_FRAME = CTLbyte & SESSION_CTL_STREAM;
+#if SESSION_USE_ZERO_COPY
+  _rxLength = 0;
+#endif
+#if SESSION_USE_RECORDS
+  SESSION_RECORDS_FRAME = CTLbyte & SESSION_CTL_RECORDS;
+  _recordOffset = 0;
+#endif
+#if SESSION_USE_MAC
+  _macLength = 0;
+#endif
  
-  // if a new session key was requested, send it right here in the interrupt to avoid having to handle it in sketch manually, and for greater speed
+  // if a new session key was requested, issue it right here in the interrupt to avoid having to handle it in sketch manually
+  // !RVDB the response is queued and sent by sessionService() (called by receiveDone()), so the interrupt
+  // handler does not wait for a whole transmission with the interrupts masked
   if (sessionKeyEnabled() && SESSION_KEY_REQUESTED && !SESSION_KEY_INCLUDED) {
-    unselect();
 //    Serial.println("SESSION_KEY_REQUESTED && NO SESSION_KEY_INCLUDED");
-    setMode(RF69_MODE_STANDBY);
-    // !RVDB use system up time to generate a key
-    SESSION_KEY = millis();
-    SESSION_KEY1 = SESSION_KEY>>24;		// !RVDB Save Session Key Higher Bytes 
-    SESSION_KEY2 = SESSION_KEY>>16;		// !RVDB Save Session Key Medium Bytes 
-    SESSION_KEY3 = SESSION_KEY>>8;		// !RVDB Save Session Key Medium Bytes 
-    SESSION_KEY4 = SESSION_KEY;			// !RVDB Save Session Key Lower Bytes 
-    // send it!
-    sendFrame(SENDERID, null, 0, false, false, true, true);
-    // don't process any data
+    DATALEN = 0;										// don't process any data
+    SESSION_TRACE_RESULT(SESSION_TRACE_REFUSED, 0);
+    if (_replyCount == SESSION_REPLY_QUEUE_SIZE) return;	// !RVDB no room for the response, the requester times out
+    // !RVDB a new request shortly after a key was issued to this node, and before any frame used it,
+    // means the key response was lost: the requester was not back in receive mode yet
+#if SESSION_USE_RESP_DELAY
+    volatile SessionPeer* last = findPeer(SENDERID);
+    if (last && last->window == 0 && !last->next && (long)(last->expires - millis()) >= 0) adaptRespDelay(SENDERID, true); // issued less than 4 x _waitTime ago
+#endif
+    // !RVDB a random key, the data frame is expected within the requester watchdog time
+    // A stream key is only given when a stream buffer is free, otherwise the requester times out
+#if SESSION_USE_STREAM
+    unsigned long key = (CTLbyte & SESSION_CTL_STREAM) ? issueStreamKey(SENDERID) : issueKey(SENDERID, 4UL * _waitTime);
+#else
+    unsigned long key = (CTLbyte & SESSION_CTL_STREAM) ? 0 : issueKey(SENDERID, 4UL * _waitTime); // streams are refused
+#endif
+    if (key == 0) return;
+    // queue it for sessionService()
+#if SESSION_USE_RESUME
+    // !RVDB with a resume ticket if the requester asks for one and we give them
+    bool ticket = (CTLbyte & SESSION_CTL_GROUP) && !(CTLbyte & SESSION_CTL_STREAM) && _resumes != NULL;
+    queueReply(SENDERID, key, hookStart, ticket ? SESSION_REPLY_TICKET : SESSION_REPLY_KEY);
+#else
+    queueReply(SENDERID, key, hookStart, SESSION_REPLY_KEY);
+#endif
+    SESSION_TRACE_RESULT(SESSION_TRACE_REPLY, key);
     SESSION_KEY_RCV_STATUS = 1;			// !RVDB Session Key is requested and send
-	DATALEN = 0;
     return;
   }
   // if both session key bits are set, the incoming packet has a new session key
   // set the session key and do not process data
-  if (sessionKeyEnabled() && SESSION_KEY_REQUESTED && SESSION_KEY_INCLUDED) {
-    // !RVDB Get the Session Bytes
-    SESSION_KEY1 = SPI.transfer(0);
-    SESSION_KEY2 = SPI.transfer(0);
-    SESSION_KEY3 = SPI.transfer(0);
-    SESSION_KEY4 = SPI.transfer(0);
-    // !RVDB Concatenate the Session Bytes 
-    SESSION_KEY = (unsigned long)(SESSION_KEY1)<<24 | (unsigned long) (SESSION_KEY2)<<16 | (unsigned long) (SESSION_KEY3) <<8 |(unsigned long) SESSION_KEY4; 
+  // !RVDB (an ACK with both bits set is an ACK carrying the next session key, handled below)
+  if (sessionKeyEnabled() && SESSION_KEY_REQUESTED && SESSION_KEY_INCLUDED && !(CTLbyte & RFM69_CTL_SENDACK)) {
+    // !RVDB Get the Session Bytes, only from the node we requested them from
+    unsigned long key = readSessionKey();
+#if SESSION_USE_MAC
+    if (_macEnabled && !macCheck(CTLbyte, key, 0, SESSION_KEY_LENGTH)) key = 0; // !RVDB forged key response
+#endif
+    SESSION_TRACE_RESULT(SESSION_TRACE_REFUSED, key);
+    if (SENDERID == SESSION_KEY_PEER && key != 0)
+    {
+      SESSION_TRACE_RESULT(SESSION_TRACE_KEY, key);
+      SESSION_KEY = key;
+      SESSION_KEY_RCV_STATUS = 2;		// !RVDB Session key is received and computed
+#if SESSION_USE_RESUME
+      // !RVDB the payload read by macCheck() is a resume ticket: the key of the last frame sent with it
+      if (_resumeEnabled && _macEnabled && (CTLbyte & SESSION_CTL_GROUP) &&
+          PAYLOADLEN == SESSION_HEADER_LENGTH - 1 + SESSION_KEY_LENGTH + SESSION_MAC_LENGTH)
+      {
+        _resumeKey = (unsigned long)DATA[0] << 24 | (unsigned long)DATA[1] << 16 | (unsigned long)DATA[2] << 8 | DATA[3];
+        _resumePeer = SENDERID;
+        _resumeLeapt = 0;
+        _resumeFailures = 0;
+      }
+#endif
+    }
     // don't process any data
 	DATALEN = 0;
-	SESSION_KEY_RCV_STATUS = 2;			// !RVDB Session key is received and computed
 //	Serial.println("SESSION_KEY_REQUESTED && SESSION_KEY_INCLUDED");
     return;
   }
   // if a session key is included, make sure it is the key we expect
   // if the key does not match, do not set DATA and return false
-  if (sessionKeyEnabled() && SESSION_KEY_INCLUDED && !SESSION_KEY_REQUESTED) {
+  if (sessionKeyEnabled() && SESSION_KEY_INCLUDED) {
     //   Serial.println("SESSION_KEY_INCLUDED && NO SESSION_KEY_REQUESTED");
     //   Serial.print("CONTROL Byte; "), Serial.println (CTLbyte,HEX);
     // !RVDB Get the Session Incoming Bytes
-    INCOMING_SESSION_KEY1 = SPI.transfer(0);
-    INCOMING_SESSION_KEY2 = SPI.transfer(0);
-    INCOMING_SESSION_KEY3 = SPI.transfer(0);
-    INCOMING_SESSION_KEY4 = SPI.transfer(0);
-    // !RVDB Concatenate the Incoming Session Bytes
-    INCOMING_SESSION_KEY = (unsigned long)(INCOMING_SESSION_KEY1)<<24 | (unsigned long) (INCOMING_SESSION_KEY2)<<16 | (unsigned long) (INCOMING_SESSION_KEY3) <<8 |(unsigned long) INCOMING_SESSION_KEY4;
-    if (INCOMING_SESSION_KEY != SESSION_KEY){
+    uint8_t headerLength = SESSION_KEY_REQUESTED ? SESSION_HEADER_LENGTH + SESSION_KEY_LENGTH : SESSION_HEADER_LENGTH;
+    INCOMING_SESSION_KEY = readSessionKey();
+    unsigned long next = SESSION_KEY_REQUESTED ? readSessionKey() : 0; // !RVDB an ACK carrying the key of our next session
+#if SESSION_USE_MAC
+    // !RVDB the MAC is checked first, so a forged frame uses neither a counter nor a stream/group slot
+    bool authentic = !_macEnabled || macCheck(CTLbyte, INCOMING_SESSION_KEY, next, headerLength - RF69_HEADER_LENGTH);
+#else
+    const bool authentic = true;
+#endif
+    SESSION_TRACE_RESULT(SESSION_TRACE_REFUSED, INCOMING_SESSION_KEY);
+    if (PAYLOADLEN < headerLength-1 || !authentic)
+    {
+      // !RVDB frame too short to hold its session header, or forged
+    }
+#if SESSION_USE_RESUME
+    else if ((CTLbyte & RFM69_CTL_SENDACK) && (CTLbyte & SESSION_CTL_GROUP))
+    {
+      // !RVDB resync answer to our resume frame: the key to go on from, 0 if the ticket is not known anymore
+      if (_resumeSent && SESSION_ACK_PENDING && SENDERID == SESSION_KEY_PEER && SENDERID == _resumePeer)
+      {
+        if (INCOMING_SESSION_KEY == 0) _resumePeer = RF69_BROADCAST_ADDR;
+        else _resumeKey = INCOMING_SESSION_KEY;
+        _resumeResync = 1;
+        SESSION_TRACE_RESULT(SESSION_TRACE_RESYNC, INCOMING_SESSION_KEY);
+      }
+      DATALEN = 0;										// not an ACK, nor a key mismatch
+      return;
+    }
+#endif
+    else if (CTLbyte & RFM69_CTL_SENDACK)
+    {
+      // !RVDB an ACK echoes the key we received for our own transmission
+      SESSION_KEY_ACCEPTED = SESSION_KEY != 0 && SENDERID == SESSION_KEY_PEER && INCOMING_SESSION_KEY == SESSION_KEY;
+      if (SESSION_KEY_ACCEPTED) SESSION_ACK_PENDING = 0;
+#if SESSION_USE_RESUME
+      if (SESSION_KEY_ACCEPTED && _resumeSent)
+      {
+        _resumeLeapt = 0;
+        _resumeFailures = 0;
+      }
+#endif
+      if (SESSION_KEY_REQUESTED)
+      {
+        // !RVDB the ACK carries the key of our next session with this node
+        if (SESSION_KEY_ACCEPTED && sessionNextKeyEnabled())
+        {
+          SESSION_NEXT_KEY = next;
+          SESSION_NEXT_KEY_PEER = SENDERID;
+          SESSION_NEXT_KEY_EXPIRES = millis() + _nextKeyTime - _waitTime; // !RVDB keep a margin on the receiver expiry
+        }
+      }
+    }
+#if SESSION_USE_RESUME
+    else if ((CTLbyte & SESSION_CTL_GROUP) && TARGETID != RF69_BROADCAST_ADDR)
+    {
+      // !RVDB a resume frame carries the epoch/counter of the resume ticket we gave to its sender. If refused,
+      // it is the duplicate of the last frame acknowledged, or the sender gets the counter to go on from
+      SESSION_KEY_ACCEPTED = TARGETID == _address && acceptResume(SENDERID, INCOMING_SESSION_KEY);
+      if (!SESSION_KEY_ACCEPTED && TARGETID == _address && (CTLbyte & RFM69_CTL_REQACK) &&
+          (repeatAck(SENDERID, INCOMING_SESSION_KEY) || resyncResume(SENDERID)))
+      {
+        SESSION_TRACE_RESULT(SESSION_TRACE_REPLY, INCOMING_SESSION_KEY);
+        DATALEN = 0;
+        return;
+      }
+    }
+#endif
+#if SESSION_USE_GROUP
+    else if (CTLbyte & SESSION_CTL_GROUP)
+    {
+      // !RVDB a group broadcast carries the epoch/counter of the group master. Only with a MAC: a forged
+      // counter near the top would have all the next broadcasts refused
+      SESSION_KEY_ACCEPTED = _macEnabled && SENDERID == _groupMaster && TARGETID == RF69_BROADCAST_ADDR && acceptGroup(INCOMING_SESSION_KEY);
+    }
+#endif
+    else if (SESSION_STREAM_FRAME)
+    {
+      // !RVDB a stream fragment carries the key issued for the stream plus its frame counter
+#if SESSION_USE_STREAM
+      SESSION_KEY_ACCEPTED = acceptStreamKey(INCOMING_SESSION_KEY);
+#endif
+    }
+    else
+    {
+      // !RVDB a data frame carries the key we issued to its sender plus its frame counter, each counter can only be used once
+      volatile SessionPeer* peer = findPeer(SENDERID);
+      if (peer && (long)(peer->expires - millis()) >= 0)
+      {
+        bool first = peer->window == 0;
+        SESSION_KEY_ACCEPTED = acceptCounter(peer, INCOMING_SESSION_KEY - peer->key);
+#if SESSION_USE_RESP_DELAY
+        if (SESSION_KEY_ACCEPTED && first) adaptRespDelay(SENDERID, false); // !RVDB the key response was received
+#endif
+      }
+      // !RVDB the last frame acknowledged to this node, sent again: its ACK was lost, the sketch already has it
+      if (!SESSION_KEY_ACCEPTED && (CTLbyte & RFM69_CTL_REQACK) && repeatAck(SENDERID, INCOMING_SESSION_KEY))
+      {
+        SESSION_TRACE_RESULT(SESSION_TRACE_REPLY, INCOMING_SESSION_KEY);
+        DATALEN = 0;
+        return;
+      }
+    }
+    if (!SESSION_KEY_ACCEPTED){
        //Serial.print ("Received frame: "); Serial.println("Session Key received DO NOT match the Session Key send");
        SESSION_KEY_RCV_STATUS = 3; 		// !RVDB The Session key received doesn't match with the expected one
+#if SESSION_USE_STATS
+       _stats.keyMismatches++;
+       volatile SessionRtt* entry = findRtt(SENDERID, false);
+       if (entry && entry->mismatches != 0xFFFF) entry->mismatches++;
+#endif
       // don't process any data
 	  DATALEN = 0;
       return;
     }
     // !RVDB if keys do match, actual data is payload minus the Session header Length -1
-    DATALEN = PAYLOADLEN - (SESSION_HEADER_LENGTH-1);  // !RVDB use the Session Key length definition
+    DATALEN = PAYLOADLEN - (headerLength-1);  // !RVDB use the Session Key length definition
+#if SESSION_USE_MAC
+    if (CTLbyte & SESSION_CTL_MAC) DATALEN = DATALEN > SESSION_MAC_LENGTH ? DATALEN - SESSION_MAC_LENGTH : 0; // !RVDB the MAC is not data
+    if (_macEnabled) _macLength = DATALEN;				// !RVDB already read by macCheck()
+#endif
        //Serial.print ("Received frame: "); Serial.println("Session Key received DO match the Session Key send");
        SESSION_KEY_RCV_STATUS = 0;		// !RVDB The received session key match the expected one
+       SESSION_STAT(framesAccepted);
+       SESSION_TRACE_RESULT(SESSION_TRACE_ACCEPTED, INCOMING_SESSION_KEY);
+#if SESSION_USE_ZERO_COPY
+    readPayload();
+#endif
+#if SESSION_USE_MAC
+    if (_macLength)
+    {
+      _macFirst = DATA[0];								// !RVDB the base class only reads DATALEN more bytes, then clears DATA[DATALEN]
+      DATALEN = 0;
+    }
+#endif
     return;
   }
+#if SESSION_USE_ZERO_COPY
+  if (!sessionKeyEnabled()) readPayload();
+#endif
 }
 
 //=============================================================================
-//  receiveBegin() - Need to clear out session flags before calling base class function
-//=============================================================================
-void RFM69_SessionKey::receiveBegin() {	
-  SESSION_KEY_INCLUDED = 0;
-  SESSION_KEY_REQUESTED = 0;
-  RFM69::receiveBegin();
-}
-
-//=============================================================================
-//  receiveDone() - Added check so if session key is enabled, incoming key is checked 
-//                  against the stored key for this session. Returns false if not matched
+//  ! RVDB New function
+//  interruptHandler() - With a receive queue, a validated frame is copied to the next
+//                       free slot (or counted as dropped) and the radio goes straight back
+//                       to receive mode. ACKs and stream fragments are still left in DATA
+//                       for receiveDone(), as the send functions wait for them there
 //=============================================================================
- bool RFM69_SessionKey::receiveDone() {
-//ATOMIC_BLOCK(ATOMIC_FORCEON)
-//{
-  if (sessionKeyEnabled() && _promiscuousMode)
+void RFM69_SessionKey::interruptHandler() {
+  uint32_t isrStart = micros();
+  if (_replySending && _mode == RF69_MODE_TX)
   {
-    return false; // !RVDB Avoid to received data when node is in promiscuous mode
+    // !RVDB "packet sent" of a queued frame: the next one, or back to receive mode
+    if (frameSent()) endReply();
+    uint32_t duration = micros() - isrStart;
+    if (duration > _isrTime) _isrTime = duration > 0xFFFF ? 0xFFFF : duration;
+    return;
+  }
+  _replySending = false;								// !RVDB cut by a mode change, if set
+  RFM69::interruptHandler();
+#if SESSION_USE_MAC
+  if (_macLength)
+  {
+    // !RVDB the payload was read and authenticated by macCheck()
+    DATA[0] = _macFirst;
+    DATALEN = _macLength;
+    if (DATALEN < RF69_MAX_DATA_LEN) DATA[DATALEN] = 0;	// add null at end of string, as the base class does
+    _macLength = 0;
+  }
+#endif
+#if SESSION_USE_TRACE
+  if (_traceStatus != 0)
+  {
+    // !RVDB one entry per frame received, with the outcome set by interruptHook()
+    traceEntry(SESSION_TRACE_RX, _traceCTL, SENDERID, _traceKey, _traceStatus, isrStart);	// interrupts are already off here
+    _traceStatus = 0;
+  }
+#endif
+  if (_mode == RF69_MODE_RX && PAYLOADLEN > 0)
+  {
+    if (sessionKeyEnabled() && SESSION_KEY_REQUESTED && !SESSION_KEY_INCLUDED)
+      receiveBegin();									// the response is queued, nothing left for receiveDone()
+    else if (sessionKeyEnabled() && !SESSION_KEY_ACCEPTED && _replyCount > 0)
+      receiveBegin();									// refused by receiveDone() anyway, the radio sends the answer queued
+#if SESSION_USE_RX_QUEUE
+    else if (_queue != NULL && !ACK_RECEIVED && !(sessionKeyEnabled() && SESSION_STREAM_FRAME))
+    {
+      if (!sessionKeyEnabled() || (SESSION_KEY_ACCEPTED && !(SESSION_USE_PROMISCUOUS && _promiscuousMode)))
+      {
+        if (_queueCount == _queueDepth) _queueDrops++;
+        else
+        {
+          uint8_t tail = _queueHead + _queueCount;
+          SessionFrame* frame = &_queue[tail < _queueDepth ? tail : tail - _queueDepth];
+          frame->senderID = SENDERID;
+          frame->targetID = TARGETID;
+          frame->rssi = RSSI;
+          frame->ctl = _lastCTL;
+          frame->length = receivedLength();
+          memcpy(frame->data, receivedData(), frame->length);
+          frame->key = INCOMING_SESSION_KEY;
+          _queueCount++;
+        }
+      }
+      receiveBegin();
+    }
+#endif
+  }
+  if (_replyCount > 0 && _mode == RF69_MODE_RX && PAYLOADLEN == 0)
+  {
+    // !RVDB nothing left for receiveDone(): start the key response (or ACK again, resync) now, the
+    // "packet sent" interrupt ends it, the response does not wait for the sketch loop
+    _replyKeep = false;
+    startReply();
+    _replySending = true;
+  }
+  uint32_t duration = micros() - isrStart;
+  if (duration > _isrTime) _isrTime = duration > 0xFFFF ? 0xFFFF : duration;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  sessionService() - Send the frames queued for a node by interruptHook() that the interrupt
+//                     handler could not start itself (a frame was waiting for receiveDone(), or
+//                     ours was being sent), and the stream selective ACKs. Called by receiveDone()
+//                     and while waiting for a session key. A frame not read yet by receiveDone() is kept
+//=============================================================================
+void RFM69_SessionKey::sessionService() {
+  while (serviceStep());
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  serviceStep() - Body of sessionService(), never waits: start the oldest queued frame, the
+//                  interrupt handler ends it ("packet sent"), sends the next ones and turns the
+//                  receiver on again. Returns true while a queued frame is being sent
+//=============================================================================
+bool RFM69_SessionKey::serviceStep() {
+  noInterrupts();
+  if (_replySending && (_mode != RF69_MODE_TX || millis() - _txStart >= RF69_TX_LIMIT_MS))
+    _replySending = false;								// cut by a mode change, or its end was missed
+  bool sending = _replySending;
+  bool start = !sending && _mode != RF69_MODE_TX && _replyCount > 0;
+  interrupts();
+  if (!start) return sending;							// nothing to send, or a frame of the sketch is being sent
+  _replyKeep = _mode == RF69_MODE_RX && PAYLOADLEN > 0;
+  startReply();
+  _replySending = true;
+  return true;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  endReply() - Called from the interrupt handler once a queued frame is sent: start the next
+//               one, or turn the receiver on again (keeping the frame not read yet by receiveDone())
+//=============================================================================
+void RFM69_SessionKey::endReply() {
+  if (_replyCount > 0)
+  {
+    startReply();
+    _replySending = true;
+    return;
+  }
+  _replySending = false;
+  if (_replyKeep)
+  {
+    writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_01);	// DIO0 is "Payload Ready", the frame in DATA stays for receiveDone()
+    setMode(RF69_MODE_RX);
+  }
+  else receiveBegin();
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  startReply() - Take the oldest queued frame (SESSION_REPLY_xxx) and start sending it
+//=============================================================================
+void RFM69_SessionKey::startReply() {
+#ifdef SREG
+  uint8_t sreg = SREG;									// !RVDB also called from the interrupt handler
+#endif
+  noInterrupts();
+  uint8_t nodeID = _replies[_replyHead].nodeID;
+  unsigned long key = _replies[_replyHead].key;
+  uint32_t time = _replies[_replyHead].time;
+  uint8_t type = _replies[_replyHead].type;
+  _replyHead = (_replyHead + 1) & (SESSION_REPLY_QUEUE_SIZE - 1);
+  _replyCount--;
+#ifdef SREG
+  SREG = sreg;
+#else
+  interrupts();
+#endif
+  // send it!
+  if (type == SESSION_REPLY_ACK)
+  {
+    startFrame(nodeID, null, 0, false, true, false, true, key); // !RVDB the ACK again, without payload
+    SESSION_STAT(ackRepeats);
+  }
+#if SESSION_USE_RESUME
+  else if (type == SESSION_REPLY_RESYNC)
+    startFrame(nodeID, null, 0, false, true, false, true, key, SESSION_CTL_GROUP); // !RVDB an ACK flagged as resync answer
+#endif
+#if SESSION_USE_STREAM
+  else if (type == SESSION_REPLY_SACK)
+  {
+    // !RVDB selective ACK of the stream as received now: first fragment missing, then one bit per following fragment
+    uint8_t sack[6] = { (uint8_t)(_stream.base >> 8), (uint8_t)_stream.base,
+      (uint8_t)(_stream.sack >> 24), (uint8_t)(_stream.sack >> 16), (uint8_t)(_stream.sack >> 8), (uint8_t)_stream.sack };
+    startFrame(nodeID, sack, sizeof(sack), false, true, false, true, key, SESSION_CTL_STREAM);
+  }
+#endif
+  else
+  {
+#if SESSION_USE_RESUME
+    unsigned long ticket;
+    if (type == SESSION_REPLY_TICKET && _resumes != NULL && issueTicket(nodeID, &ticket))
+    {
+      uint8_t data[SESSION_KEY_LENGTH] = { (uint8_t)(ticket>>24), (uint8_t)(ticket>>16), (uint8_t)(ticket>>8), (uint8_t)ticket };
+      startFrame(nodeID, data, SESSION_KEY_LENGTH, false, false, true, true, key, SESSION_CTL_GROUP);
+    }
+    else
+#endif
+    startFrame(nodeID, null, 0, false, false, true, true, key);
+    _keyResponseLoadTime = micros() - time;				// !RVDB time from the request to the key response loaded in the FIFO
+    SESSION_STAT(keysIssued);
+  }
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  readSessionKey() - Read the 4 session key bytes (higher byte first) from the FIFO
+//=============================================================================
+unsigned long RFM69_SessionKey::readSessionKey() {
+  uint8_t key[SESSION_KEY_LENGTH] = {0, 0, 0, 0};		// !RVDB one block transfer, 0 is clocked out while reading
+  SPI.transfer(key, SESSION_KEY_LENGTH);
+  return (unsigned long)key[0] << 24 | (unsigned long)key[1] << 16 | (unsigned long)key[2] << 8 | key[3];
+}
+
+#if SESSION_USE_ZERO_COPY
+//=============================================================================
+//  ! RVDB New function
+//  readPayload() - With a receive buffer, read the payload following the session header
+//                  from the FIFO straight into it with one block transfer (the bytes clocked
+//                  out are ignored by the radio). DATALEN is set to 0 so the base class copies
+//                  nothing to DATA, the bytes not fitting in the buffer are dropped.
+//                  Stream fragments are still received in DATA for streamFragment()
+//=============================================================================
+void RFM69_SessionKey::readPayload() {
+  if (_rxBuffer == NULL || DATALEN == 0 || SESSION_STREAM_FRAME) return;
+  uint8_t length = DATALEN < _rxSize ? DATALEN : _rxSize;
+#if SESSION_USE_MAC
+  if (_macLength)
+  {
+    memcpy(_rxBuffer, (const uint8_t*)DATA, length);	// !RVDB already read by macCheck()
+    _macLength = 0;
+  }
+  else
+#endif
+  SPI.transfer(_rxBuffer, length);
+  _rxLength = length;
+  DATALEN = 0;
+}
+#endif
+
+#if SESSION_USE_MAC
+//=============================================================================
+//  ! RVDB New function
+//  macCheck() - Read the payload and the MAC following the session key(s) from the FIFO into DATA,
+//               and check the MAC over the header, key(s) and payload. keyLength is 4, or 8 for an
+//               ACK carrying the next session key. A frame without SESSION_CTL_MAC is refused
+//=============================================================================
+bool RFM69_SessionKey::macCheck(uint8_t CTLbyte, unsigned long key, unsigned long nextKey, uint8_t keyLength) {
+  uint8_t headerLength = RF69_HEADER_LENGTH - 1 + keyLength + SESSION_MAC_LENGTH; // !RVDB PAYLOADLEN does not count itself
+  if (!(CTLbyte & SESSION_CTL_MAC) || PAYLOADLEN < headerLength || PAYLOADLEN - headerLength + SESSION_MAC_LENGTH > RF69_MAX_DATA_LEN) return false;
+  uint8_t dataLength = PAYLOADLEN - headerLength;
+  uint8_t* data = (uint8_t*)DATA;
+  SPI.transfer(data, dataLength + SESSION_MAC_LENGTH);	// !RVDB one block transfer, as readPayload()
+  uint8_t header[RF69_HEADER_LENGTH + 2 * SESSION_KEY_LENGTH] = { (uint8_t)PAYLOADLEN, (uint8_t)TARGETID, (uint8_t)SENDERID, CTLbyte,
+    (uint8_t)(key>>24), (uint8_t)(key>>16), (uint8_t)(key>>8), (uint8_t)key,
+    (uint8_t)(nextKey>>24), (uint8_t)(nextKey>>16), (uint8_t)(nextKey>>8), (uint8_t)nextKey };
+  _mac.begin();
+  _mac.update(header, RF69_HEADER_LENGTH + keyLength);
+  _mac.update(data, dataLength);
+  uint32_t tag = _mac.finish();
+  const uint8_t* received = data + dataLength;
+  return received[0] == (uint8_t)tag && received[1] == (uint8_t)(tag>>8) &&
+         received[2] == (uint8_t)(tag>>16) && received[3] == (uint8_t)(tag>>24);
+}
+#endif
+
+//=============================================================================
+//  ! RVDB New function
+//  issueKey() - Generate a new session key for a peer, valid for lifeTime ms
+//               (random, never 0 as 0 marks a free entry). 0 is returned
+//               when both table slots of the peer hold a key still used by other
+//               peers (counted in keysRefused for a key request)
+//=============================================================================
+unsigned long RFM69_SessionKey::issueKey(uint8_t nodeID, unsigned long lifeTime, bool next) {
+  volatile SessionPeer* peer = allocPeer(nodeID);
+  if (peer == NULL)
+  {
+    if (!next) SESSION_STAT(keysRefused);
+    return 0;
+  }
+  unsigned long key = newKey();
+  peer->nodeID = nodeID;
+  peer->key = key;
+  peer->expires = millis() + lifeTime;
+  peer->highest = 0;
+  peer->window = 0;
+  peer->next = next;
+  return key;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  repeatAck() - Called from the interrupt handler for a frame with a key already used: if it is
+//                the key of the last ACK sent to nodeID, within the key lifetime (4 x sessionWaitTime),
+//                that ACK was lost. Queue it again for sessionService() (once per frame) and send
+//                more ACK copies to this node. Returns false if the frame is not such a duplicate
+//=============================================================================
+bool RFM69_SessionKey::repeatAck(uint8_t nodeID, unsigned long key) {
+  volatile SessionRtt* entry = findRtt(nodeID, false);
+  if (entry == NULL || key == 0 || entry->ackedKey != key || millis() - entry->ackedTime > 4UL * _waitTime) return false;
+  entry->ackedKey = 0;									// a replayed duplicate gets no more ACK
+#if SESSION_USE_3ACKS
+  if (entry->ackCopies < SESSION_ACK_COPIES_MAX) entry->ackCopies++;
+  entry->ackClean = 0;
+#endif
+  queueReply(nodeID, key, micros(), SESSION_REPLY_ACK);	// if no room, the sender requests a new key
+  return true;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  queueReply() - Called from the interrupt handler: queue a frame of type SESSION_REPLY_xxx to nodeID
+//                 for sessionService(). Returns false if the queue is full
+//=============================================================================
+bool RFM69_SessionKey::queueReply(uint8_t nodeID, unsigned long key, uint32_t time, uint8_t type) {
+  if (_replyCount == SESSION_REPLY_QUEUE_SIZE) return false;
+  volatile SessionReply* reply = &_replies[(_replyHead + _replyCount) & (SESSION_REPLY_QUEUE_SIZE - 1)];
+  reply->nodeID = nodeID;
+  reply->key = key;
+  reply->time = time;
+  reply->type = type;
+  _replyCount++;
+  return true;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  acceptCounter() - Check the counter of a frame received from a peer against its replay
+//                    window. The burst session starts at the first frame and ends after
+//                    _burstFrames frames or _burstTime ms
+//=============================================================================
+bool RFM69_SessionKey::acceptCounter(volatile SessionPeer* peer, unsigned long counter) {
+  if (counter >= _burstFrames) return false;
+  if (peer->window == 0 && _burstFrames > 1) peer->expires = millis() + _burstTime;
+  if (!acceptWindow(peer->highest, peer->window, counter)) return false;
+  if (counter == _burstFrames - 1U) peer->key = 0;	// last frame of the session
+  return true;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  acceptWindow() - Sliding replay window: bit i of window is set once the frame counter
+//                   (highest - i) is accepted, each counter is accepted only once
+//=============================================================================
+bool RFM69_SessionKey::acceptWindow(volatile uint16_t& highest, volatile uint32_t& window, uint16_t counter) {
+  if (window == 0)										// first frame
+  {
+    highest = counter;
+    window = 1;
+  }
+  else if (counter > highest)
+  {
+    uint16_t shift = counter - highest;
+    window = shift < 32 ? (window << shift) | 1 : 1;
+    highest = counter;
+  }
+  else
+  {
+    uint16_t age = highest - counter;
+    if (age >= 32 || (window & (1UL << age))) return false; // too old or replayed
+    window |= 1UL << age;
+  }
+  return true;
+}
+
+#if SESSION_USE_GROUP
+//=============================================================================
+//  ! RVDB New function
+//  acceptGroup() - A group broadcast is accepted once, when its epoch/counter is above the
+//                  last one accepted (the lowest epoch given to useSessionGroup() at start)
+//=============================================================================
+bool RFM69_SessionKey::acceptGroup(unsigned long counter) {
+  if (counter <= _groupCounter) return false;			// replayed, repeated or from an older epoch
+  _groupCounter = counter;
+  return true;
+}
+#endif
+
+#if SESSION_USE_RESUME
+// !RVDB the counters of a saved resume table are 3 bytes, most significant first
+static void putCounter(uint8_t* data, uint32_t counter) {
+  data[0] = counter >> 16;
+  data[1] = counter >> 8;
+  data[2] = counter;
+}
+
+static uint32_t getCounter(const uint8_t* data) {
+  return (uint32_t)data[0] << 16 | (uint16_t)data[1] << 8 | data[2];
+}
+
+// !RVDB Fletcher checksum of a saved resume table, never 0x0000 nor 0xFFFF (erased or cleared store)
+static uint16_t resumeChecksum(const uint8_t* data, uint8_t length) {
+  uint16_t a = 1, b = 0;
+  for (uint8_t i = 0; i < length; i++)
+  {
+    a = (a + data[i]) % 255;
+    b = (b + a) % 255;
+  }
+  return b << 8 | a;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  resumeKey() - Get the key of the next frame to toAddress from the resume ticket it gave us: the
+//                next counter, the frame is sent with SESSION_CTL_GROUP and its MAC. Returns false
+//                when there is no ticket from this node, a session key must be requested
+//=============================================================================
+bool RFM69_SessionKey::resumeKey(uint8_t toAddress) {
+  if (!_resumeEnabled || !_macEnabled || _resumePeer != toAddress) return false;
+  noInterrupts();
+  unsigned long key = _resumeKey + 1;
+  if ((key & SESSION_RESUME_COUNTER) == 0)
+  {
+    _resumePeer = RF69_BROADCAST_ADDR;					// counters used up, the key request asks for a new ticket
+    interrupts();
+    return false;
+  }
+  _resumeKey = key;
+  interrupts();
+  SESSION_KEY = key;
+  SESSION_KEY_PEER = toAddress;
+  SESSION_KEY_RCV_STATUS = 2;  // !RVDB Sender: the session key is computed
+  _resumeSent = 1;
+  return true;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  resumeFailed() - A frame sent with the resume ticket got no answer, the gateway may be restarting:
+//                   its restored reservation is at most SESSION_RESUME_BLOCK above the last counter it
+//                   accepted, the next counter leaps above it (once until an ACK). The ticket is dropped
+//                   after SESSION_RESUME_FAILURES such frames, the gateway may not give tickets anymore
+//=============================================================================
+void RFM69_SessionKey::resumeFailed() {
+  if (!_resumeSent) return;
+  noInterrupts();
+  if (_resumePeer != RF69_BROADCAST_ADDR)
+  {
+    if (++_resumeFailures >= SESSION_RESUME_FAILURES ||
+        (_resumeKey & SESSION_RESUME_COUNTER) >= SESSION_RESUME_COUNTER - SESSION_RESUME_BLOCK)
+      _resumePeer = RF69_BROADCAST_ADDR;
+    else if (!_resumeLeapt)
+    {
+      _resumeKey += SESSION_RESUME_BLOCK;
+      _resumeLeapt = 1;
+    }
+  }
+  interrupts();
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  findResume() - Look up the resume ticket given to a node, NULL if none
+//=============================================================================
+SessionResume* RFM69_SessionKey::findResume(uint8_t nodeID) {
+  for (uint8_t i = 0; i < _resumeCount; i++)
+    if (_resumes[i].nodeID == nodeID) return &_resumes[i];
+  return NULL;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  acceptResume() - A resume frame (its MAC checked) is accepted when its counter is above the last
+//                   one accepted from the node, and not above the reservation saved in the store, so
+//                   it is still refused after a restart. A reservation running out is saved again by
+//                   sessionResumeFlush()
+//=============================================================================
+bool RFM69_SessionKey::acceptResume(uint8_t nodeID, unsigned long key) {
+  SessionResume* entry = _macEnabled ? findResume(nodeID) : NULL;
+  if (entry == NULL || (uint8_t)(key >> 24) != _resumeEpoch) return false;
+  uint32_t counter = key & SESSION_RESUME_COUNTER;
+  if (counter <= entry->highest || counter > entry->reserved) return false; // replayed, or above the reservation
+  entry->highest = counter;
+  if (entry->reserved - counter < SESSION_RESUME_BLOCK / 2) _resumeDirty = 1;
+  return true;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  resyncResume() - Queue the answer to a refused resume frame for sessionService(): the key to go on
+//                   from (epoch and last counter accepted), 0 when the node has no ticket anymore.
+//                   Returns false without MAC, the answer could be forged
+//=============================================================================
+bool RFM69_SessionKey::resyncResume(uint8_t nodeID) {
+  if (!_macEnabled) return false;
+  SessionResume* entry = findResume(nodeID);
+  return queueReply(nodeID, entry != NULL ? (unsigned long)_resumeEpoch << 24 | entry->highest : 0, micros(), SESSION_REPLY_RESYNC);
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  issueTicket() - Give a resume ticket to a node in its session key response: the epoch and the last
+//                  counter accepted, the node goes on from the next one. A ticket is never taken
+//                  back from a node (it would be refused at each frame and come back for a new one),
+//                  returns false when all are given: the node gets a session key response only
+//=============================================================================
+bool RFM69_SessionKey::issueTicket(uint8_t nodeID, unsigned long* ticket) {
+#ifdef SREG
+  uint8_t sreg = SREG;									// !RVDB called by startReply(), from the interrupt handler too
+#endif
+  noInterrupts();
+  SessionResume* entry = findResume(nodeID);
+  if (entry == NULL && (entry = findResume(RF69_BROADCAST_ADDR)) != NULL)
+  {
+    entry->nodeID = nodeID;								// unused in this epoch, counters from 0
+    entry->highest = 0;
+    entry->reserved = 0;								// nothing accepted before sessionResumeFlush() saves a reservation
+    _resumeDirty = 1;
+  }
+  if (entry != NULL) *ticket = (unsigned long)_resumeEpoch << 24 | entry->highest;
+#ifdef SREG
+  SREG = sreg;
+#else
+  interrupts();
+#endif
+  return entry != NULL;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  saveResume() - Reserve reserve counters above the last one accepted for the tickets whose reservation
+//                 runs out, and write the resume table in the next store slot with the next sequence
+//                 number, the slots wear evenly. The new reservations are used once written. Called
+//                 from sessionResumeFlush(), an EEPROM write takes a few ms per byte changed. When the
+//                 counters run out a new epoch starts without tickets, the nodes ask for new ones
+//=============================================================================
+void RFM69_SessionKey::saveResume(uint32_t reserve) {
+  if (_resumes == NULL) return;
+  uint8_t record[SESSION_RESUME_RECORD_LENGTH(SESSION_RESUME_MAX_TICKETS)];
+  uint8_t length = SESSION_RESUME_RECORD_LENGTH(_resumeCount);
+  noInterrupts();
+  _resumeDirty = 0;
+  bool full = false;
+  for (uint8_t i = 0; i < _resumeCount; i++)
+    if (_resumes[i].nodeID != RF69_BROADCAST_ADDR && _resumes[i].reserved >= SESSION_RESUME_COUNTER - SESSION_RESUME_WINDOW)
+      full = true;
+  if (full)
+  {
+    _resumeEpoch = _resumeEpoch == 0xFF ? 1 : _resumeEpoch + 1; // the frames of the last epoch are refused
+    for (uint8_t i = 0; i < _resumeCount; i++)
+      _resumes[i].nodeID = RF69_BROADCAST_ADDR;
+  }
+  record[0] = _storeSeq + 1;
+  record[1] = _resumeEpoch;
+  for (uint8_t i = 0; i < _resumeCount; i++)
+  {
+    uint32_t reserved = _resumes[i].reserved;
+    if (_resumes[i].nodeID != RF69_BROADCAST_ADDR && reserved - _resumes[i].highest < reserve / 2)
+      reserved = _resumes[i].highest + reserve;
+    record[2 + 4 * i] = _resumes[i].nodeID;
+    putCounter(record + 3 + 4 * i, reserved);
+  }
+  interrupts();
+  uint16_t checksum = resumeChecksum(record, length - 2);
+  record[length - 2] = checksum;
+  record[length - 1] = checksum >> 8;
+  _storeSlot = _storeSlot + 1 < _storeSlots ? _storeSlot + 1 : 0;
+  _storeSeq++;
+  _storeWrite(_storeAddress + (uint16_t)_storeSlot * length, record, length);
+  // !RVDB the counters up to the new reservations may be accepted now they are saved
+  noInterrupts();
+  for (uint8_t i = 0; i < _resumeCount; i++)
+    if (_resumes[i].nodeID == record[2 + 4 * i]) _resumes[i].reserved = getCounter(record + 3 + 4 * i);
+  interrupts();
+}
+#endif
+
+#if SESSION_USE_STREAM
+//=============================================================================
+//  ! RVDB New function
+//  issueStreamKey() - Generate the session key of a stream requested by a peer. Only one
+//                     stream is received at a time, in the buffer given to receiveStream()
+//=============================================================================
+unsigned long RFM69_SessionKey::issueStreamKey(uint8_t nodeID) {
+  if (_stream.buffer == NULL || _stream.state == 2) return 0; // no buffer, or the last stream is not read yet
+  if (_stream.state == 1 && _stream.nodeID != nodeID && (long)(_stream.expires - millis()) >= 0) return 0;
+  unsigned long key = newKey();
+  _stream.state = 1;
+  _stream.nodeID = nodeID;
+  _stream.key = key;
+  _stream.expires = millis() + 16UL * _waitTime;
+  _stream.highest = 0;
+  _stream.window = 0;
+  _stream.length = 0;
+  _stream.base = 0;
+  _stream.sack = 0;
+  return key;
+}
+#endif
+
+#if SESSION_USE_STREAM
+//=============================================================================
+//  ! RVDB New function
+//  acceptStreamKey() - Check the session key of a stream fragment. The stream is dropped
+//                      when no fragment is received for 16 x _waitTime
+//=============================================================================
+bool RFM69_SessionKey::acceptStreamKey(unsigned long key) {
+  if (_stream.key == 0 || _stream.nodeID != SENDERID || (long)(_stream.expires - millis()) < 0) return false;
+  unsigned long counter = key - _stream.key;
+  if (counter > 0xFFFF || !acceptWindow(_stream.highest, _stream.window, counter)) return false;
+  _stream.expires = millis() + 16UL * _waitTime;
+  return true;
+}
+#endif
+
+#if SESSION_USE_STREAM
+//=============================================================================
+//  ! RVDB New function
+//  streamFragment() - Copy a received stream fragment in the stream buffer, and queue the
+//                     selective ACK when requested. Fragments received again are only acknowledged
+//=============================================================================
+void RFM69_SessionKey::streamFragment() {
+  uint8_t sender = SENDERID;
+  unsigned long key = INCOMING_SESSION_KEY;
+  bool ackRequested = ACK_REQUESTED;
+  if (_stream.state == 1 && DATALEN >= SESSION_STREAM_HEADER_LENGTH)
+  {
+    uint16_t index = (uint16_t)DATA[0] << 8 | DATA[1];
+    uint16_t length = (uint16_t)DATA[2] << 8 | DATA[3];
+    if (_stream.length == 0)
+    {
+      if (length == 0 || length > _stream.size)		// doesn't fit, drop the stream
+      {
+        _stream.state = 0;
+        _stream.key = 0;
+        return;
+      }
+      _stream.length = length;
+    }
+    uint32_t offset = (uint32_t)index * SESSION_STREAM_DATA_LEN;
+    if (index >= _stream.base && index - _stream.base < 32 && offset < _stream.length)
+    {
+      uint8_t size = DATALEN - SESSION_STREAM_HEADER_LENGTH;
+      if (offset + size > _stream.length) size = _stream.length - offset;
+      for (uint8_t i = 0; i < size; i++)
+        _stream.buffer[offset + i] = DATA[SESSION_STREAM_HEADER_LENGTH + i];
+      _stream.sack |= 1UL << (index - _stream.base);
+      while (_stream.sack & 1)
+      {
+        _stream.sack >>= 1;
+        _stream.base++;
+      }
+      if ((uint32_t)_stream.base * SESSION_STREAM_DATA_LEN >= _stream.length) _stream.state = 2;
+    }
+  }
+  if (ackRequested && _stream.key != 0 && sender == _stream.nodeID)
+  {
+    // !RVDB the selective ACK is sent by the next sessionService() or poll(), if no room the sender sends the window again
+    noInterrupts();
+    queueReply(sender, key, micros(), SESSION_REPLY_SACK);
+    interrupts();
+  }
+}
+#endif
+
+//=============================================================================
+//  ! RVDB New function
+//  findPeer() - Look up the session table entry of a peer. A peer lives either in
+//               its home slot (nodeID modulo the table size) or in the next one,
+//               so the lookup stays O(1) inside the interrupt handler
+//=============================================================================
+volatile SessionPeer* RFM69_SessionKey::findPeer(uint8_t nodeID) {
+  uint8_t slot = nodeID & (SESSION_PEER_TABLE_SIZE - 1);
+  if (_peers[slot].key != 0 && _peers[slot].nodeID == nodeID) return &_peers[slot];
+  slot = (slot + 1) & (SESSION_PEER_TABLE_SIZE - 1);
+  if (_peers[slot].key != 0 && _peers[slot].nodeID == nodeID) return &_peers[slot];
+  return NULL;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  allocPeer() - Get the session table entry for a new key of a peer: its current
+//                entry, else a free or expired one of its two slots, else an unused
+//                next key (lasting minutes) is evicted. A key in use or requested is
+//                never evicted, that peer would get a key mismatch: NULL is returned,
+//                the requester gets no response and backs off
+//=============================================================================
+volatile SessionPeer* RFM69_SessionKey::allocPeer(uint8_t nodeID) {
+  volatile SessionPeer* peer = findPeer(nodeID);
+  if (peer) return peer;
+  uint32_t now = millis();
+  volatile SessionPeer* home = &_peers[nodeID & (SESSION_PEER_TABLE_SIZE - 1)];
+  volatile SessionPeer* next = &_peers[(nodeID + 1) & (SESSION_PEER_TABLE_SIZE - 1)];
+  if (home->key == 0 || (long)(home->expires - now) < 0) return home;
+  if (next->key == 0 || (long)(next->expires - now) < 0) return next;
+  bool homeIdle = home->next && home->window == 0;		// a next key not used yet
+  bool nextIdle = next->next && next->window == 0;
+  if (homeIdle && nextIdle) return (long)(home->expires - next->expires) <= 0 ? home : next;
+  if (homeIdle) return home;
+  if (nextIdle) return next;
+  return NULL;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  findRtt() - Look up the round trip time estimate of a node. With create, a node
+//              without estimate replaces the oldest entry (round robin), whose per
+//              peer counters are lost: counted in the peerEvictions statistic. An
+//              entry whose last ACK may still be repeated (repeatAck) is skipped,
+//              unless all are
+//=============================================================================
+volatile SessionRtt* RFM69_SessionKey::findRtt(uint8_t nodeID, bool create) {
+  for (uint8_t i = 0; i < SESSION_PEER_TABLE_SIZE; i++)
+    if (_rtt[i].nodeID == nodeID) return &_rtt[i];
+  if (!create) return NULL;
+  uint32_t now = millis();
+  uint8_t slot = _rttNext;
+  for (uint8_t i = 0; i < SESSION_PEER_TABLE_SIZE; i++)
+  {
+    uint8_t candidate = (_rttNext + i) & (SESSION_PEER_TABLE_SIZE - 1);
+    if (_rtt[candidate].ackedKey == 0 || now - _rtt[candidate].ackedTime > 4UL * _waitTime)
+    {
+      slot = candidate;
+      break;
+    }
+  }
+  volatile SessionRtt* rtt = &_rtt[slot];
+  _rttNext = (slot + 1) & (SESSION_PEER_TABLE_SIZE - 1);
+  if (rtt->nodeID != RF69_BROADCAST_ADDR) SESSION_STAT(peerEvictions);
+  rtt->nodeID = nodeID;
+  rtt->srtt = 0;
+  rtt->rttvar = 0;
+  rtt->ackedKey = 0;
+#if SESSION_USE_3ACKS
+  rtt->ackCopies = 0;
+  rtt->ackClean = 0;
+#endif
+#if SESSION_USE_RESP_DELAY
+  rtt->respDelay = _respDelayTime;
+#endif
+#if SESSION_USE_STATS
+  rtt->handshakes = 0;
+  rtt->failures = 0;
+  rtt->mismatches = 0;
+#endif
+  return rtt;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  rttSample() - Update the round trip time estimate of a node with a measured round
+//                trip (us): srtt += (rtt - srtt) / 8, rttvar += (|rtt - srtt| - rttvar) / 4
+//=============================================================================
+void RFM69_SessionKey::rttSample(uint8_t nodeID, uint32_t rtt) {
+  if (rtt > 0xFFFF) rtt = 0xFFFF;
+  if (rtt == 0) rtt = 1;								// 0 marks an entry without sample
+  noInterrupts();										// the table is also used by the interrupt handler
+  volatile SessionRtt* entry = findRtt(nodeID, true);
+  if (entry->srtt == 0)									// first sample
+  {
+    entry->srtt = rtt;
+    entry->rttvar = rtt / 2;
+  }
+  else
+  {
+    long error = (long)rtt - entry->srtt;
+    entry->rttvar += ((error < 0 ? -error : error) - (long)entry->rttvar) / 4;
+    entry->srtt += error / 8;
+  }
+  interrupts();
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  rttTimeout() - No answer within the timeout: double the variation (plus 1ms) so the
+//                 next timeout is longer, up to the sessionWaitTime() upper bound
+//=============================================================================
+void RFM69_SessionKey::rttTimeout(uint8_t nodeID) {
+  noInterrupts();
+  volatile SessionRtt* entry = findRtt(nodeID, false);
+  if (entry && entry->srtt != 0)
+  {
+    uint32_t rttvar = 2UL * entry->rttvar + 1000;
+    entry->rttvar = rttvar > 0xFFFF ? 0xFFFF : rttvar;
+  }
+  interrupts();
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  sessionTimeout() - Timeout (ms) of an answer from a node: srtt + 4 x rttvar, between
+//                     SESSION_MIN_WAIT_TIME and maxTime (maxTime if the node has no estimate)
+//=============================================================================
+uint16_t RFM69_SessionKey::sessionTimeout(uint8_t nodeID, uint16_t maxTime) {
+  volatile SessionRtt* entry = findRtt(nodeID, false);
+  if (entry == NULL || entry->srtt == 0 || entry->srtt == 0xFFFF) return maxTime;
+  uint32_t timeout = ((uint32_t)entry->srtt + 4UL * entry->rttvar) / 1000 + 1;
+  if (timeout < SESSION_MIN_WAIT_TIME) timeout = SESSION_MIN_WAIT_TIME;
+  return timeout < maxTime ? timeout : maxTime;
+}
+
+#if SESSION_USE_RESP_DELAY
+//=============================================================================
+//  ! RVDB New function
+//  respDelay() - Delay (us) before a session frame to a node, sessionRespDelayTime()
+//                until a key response to this node was lost
+//=============================================================================
+uint16_t RFM69_SessionKey::respDelay(uint8_t nodeID) {
+  volatile SessionRtt* entry = findRtt(nodeID, false);
+  return entry && entry->respDelay > _respDelayTime ? entry->respDelay : _respDelayTime;
+}
+#endif
+
+#if SESSION_USE_RESP_DELAY
+//=============================================================================
+//  ! RVDB New function
+//  adaptRespDelay() - Called from the interrupt handler: a lost key response doubles the
+//                     delay (plus 50us) up to SESSION_MAX_RESP_DELAY, a received one
+//                     decreases it by 1/8 down to sessionRespDelayTime()
+//=============================================================================
+void RFM69_SessionKey::adaptRespDelay(uint8_t nodeID, bool lost) {
+  volatile SessionRtt* entry = findRtt(nodeID, lost);
+  if (entry == NULL) return;
+  uint16_t delay = entry->respDelay;
+  if (lost) delay = delay < (SESSION_MAX_RESP_DELAY - 50) / 2 ? 2 * delay + 50 : SESSION_MAX_RESP_DELAY;
+  else delay -= delay / 8;
+  entry->respDelay = delay < _respDelayTime ? _respDelayTime : delay;
+}
+#endif
+
+//=============================================================================
+//  ! RVDB New function
+//  waitCanSend() - Wait up to RF69_CSMA_LIMIT_MS for the channel to be free, calling receiveDone()
+//                  meanwhile as RFM69::send() does. With backoff, once the channel becomes free,
+//                  wait a random time within a window doubled each time the channel is found busy
+//                  again, so the nodes waiting for the same frame to end don't all start together.
+//                  A frame received during the backoff is not read here: the channel is free
+//                  again once it has ended, and the frame stays in DATA
+//=============================================================================
+void RFM69_SessionKey::waitCanSend(bool backoff) {
+  if (canSend()) return;
+  SESSION_STAT(csmaWaits);
+  uint32_t now = millis();
+  uint8_t exponent = 0;
+  while (millis() - now < RF69_CSMA_LIMIT_MS)
+  {
+    if (!canSend())
+    {
+      receiveDone();
+      continue;
+    }
+    if (!backoff || _backoffSlot == 0) return;
+    receiveBegin();										// canSend() put the radio in standby
+    if (exponent < _backoffMax) exponent++;
+    backoffWait(exponent);
+    if (_mode == RF69_MODE_RX && PAYLOADLEN > 0) return;	// a frame was received during the backoff, leave it in DATA
+    if (canSend()) return;
+  }
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  backoffTime() - Random backoff (ms) from 0 to 2^exponent slots (exponent up to sessionBackoff()
+//                  maxExponent). xorshift32 mixed with micros(), random() is left to the sketch
+//=============================================================================
+uint16_t RFM69_SessionKey::backoffTime(uint8_t exponent) {
+  if (_backoffSlot == 0) return 0;
+  if (exponent > _backoffMax) exponent = _backoffMax;
+  uint32_t x = _backoffSeed ^ micros();
+  if (x == 0) x = 1;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  _backoffSeed = x;
+  return x % ((uint16_t)_backoffSlot << exponent);
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  newKey() - A new session key, called with interrupts off: xorshift32 mixed with micros() at
+//             each call, so two keys issued in the same ms differ and a key does not tell the next
+//             one as millis() did. From 1 to 2^31: the frame counters added to it never give 0 (no key)
+//=============================================================================
+unsigned long RFM69_SessionKey::newKey() {
+  uint32_t x = _keySeed ^ micros();
+  if (x == 0) x = 1;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  _keySeed = x;
+  return (x >> 1) + 1;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  backoffWait() - Wait a random backoff. Only the queued session key responses
+//                  are sent meanwhile (sessionService), the frames received are not read
+//=============================================================================
+void RFM69_SessionKey::backoffWait(uint8_t exponent) {
+  uint16_t wait = backoffTime(exponent);
+  uint32_t start = millis();
+  while (millis() - start < wait) sessionService();
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  countHandshake() - Count a session key received from a node latency us after the
+//                     request was sent, and use the latency as a round trip sample
+//=============================================================================
+void RFM69_SessionKey::countHandshake(uint8_t nodeID, uint32_t latency) {
+  rttSample(nodeID, latency);
+  _handshakeTime = latency > 0xFFFF ? 0xFFFF : latency;
+#if SESSION_USE_STATS
+  uint8_t bucket = 0;
+  for (uint32_t bound = 1UL << SESSION_STATS_FIRST_BUCKET; latency >= bound && bucket < SESSION_STATS_BUCKETS - 1; bound <<= 1)
+    bucket++;
+  noInterrupts();
+  _stats.handshakesCompleted++;
+  if (_stats.latency[bucket] != 0xFFFF) _stats.latency[bucket]++;
+  volatile SessionRtt* entry = findRtt(nodeID, false);	// created by rttSample()
+  if (entry && entry->handshakes != 0xFFFF) entry->handshakes++;
+  interrupts();
+#endif
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  countAck() - An ACK was received from a node latency us after the frame was sent,
+//               use the latency as a round trip sample
+//=============================================================================
+void RFM69_SessionKey::countAck(uint8_t nodeID, uint32_t latency) {
+  rttSample(nodeID, latency);
+  _ackTime = latency > 0xFFFF ? 0xFFFF : latency;
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  countKeyTimeout() - Count a session key request to a node without answer
+//=============================================================================
+void RFM69_SessionKey::countKeyTimeout(uint8_t nodeID) {
+  rttTimeout(nodeID);
+  SESSION_TRACE(SESSION_TRACE_TIMEOUT, 0, nodeID, 0, SESSION_SEND_KEY_WAIT, micros());
+#if SESSION_USE_STATS
+  noInterrupts();
+  _stats.keyTimeouts++;
+  volatile SessionRtt* entry = findRtt(nodeID, false);
+  if (entry && entry->failures != 0xFFFF) entry->failures++;
+  interrupts();
+#endif
+}
+
+#if SESSION_USE_TRACE
+//=============================================================================
+//  ! RVDB New function
+//  trace() - Record an event from the sketch side, with the interrupts off while the entry is written
+//=============================================================================
+void RFM69_SessionKey::trace(uint8_t event, uint8_t ctl, uint8_t peer, unsigned long key, uint8_t status, uint32_t time) {
+  if (!_traceEnabled) return;
+#ifdef SREG
+  uint8_t sreg = SREG;
+#endif
+  noInterrupts();
+  traceEntry(event, ctl, peer, key, status, time);
+#ifdef SREG
+  SREG = sreg;
+#else
+  interrupts();
+#endif
+}
+
+//=============================================================================
+//  ! RVDB New function
+//  traceEntry() - Write the next entry of the trace ring, over the oldest one. The interrupts
+//                 must be off: called as is by the interrupt handler, so that the interrupt
+//                 state is never changed inside the handler (no SREG outside AVR)
+//=============================================================================
+void RFM69_SessionKey::traceEntry(uint8_t event, uint8_t ctl, uint8_t peer, unsigned long key, uint8_t status, uint32_t time) {
+  if (!_traceEnabled) return;
+  uint16_t count = _traceCount;
+  volatile SessionTraceEntry* entry = &_trace[count & (SESSION_TRACE_SIZE - 1)];
+  _traceCount = count != 0xFFFF ? count + 1 : SESSION_TRACE_SIZE;	// still a full ring once the counter wraps
+  entry->time = time;
+  entry->event = event;
+  entry->ctl = ctl;
+  entry->peer = peer;
+  entry->status = status;
+  entry->key = key;
+}
+#endif
+
+//=============================================================================
+//  receiveBegin() - Need to clear out session flags before calling base class function
+//                   !RVDB not while a queued frame is on air, the interrupt handler turns
+//                   the receiver on once it is sent
+//=============================================================================
+void RFM69_SessionKey::receiveBegin() {	
+  if (_replySending) return;
+  SESSION_KEY_INCLUDED = 0;
+  SESSION_KEY_REQUESTED = 0;
+  SESSION_KEY_ACCEPTED = 0;
+  RFM69::receiveBegin();
+}
+
+//=============================================================================
+//  receiveDone() - Added check so if session key is enabled, incoming key is checked 
+//                  against the stored key for this session. Returns false if not matched
+//=============================================================================
+ bool RFM69_SessionKey::receiveDone() {
+//ATOMIC_BLOCK(ATOMIC_FORCEON)
+//{
+#if SESSION_USE_PROMISCUOUS
+  if (sessionKeyEnabled() && _promiscuousMode)
+  {
+    return false; // !RVDB Avoid to received data when node is in promiscuous mode
   }
+#endif
+  sessionService();										// !RVDB send the queued session key responses
 #ifdef SREG  		// !RVDB check for AVR environment
 _SREG = SREG; 		//  Save Interrupt Control
 #endif
   noInterrupts(); // re-enabled in unselect() via setMode() or via receiveBegin()
+  if (_replySending)									// !RVDB a queued frame started meanwhile by the interrupt handler is on air
+  {
+#ifdef SREG
+    SREG = _SREG;
+#endif
+    interrupts();
+    return false;
+  }
   if (_mode == RF69_MODE_RX && PAYLOADLEN > 0)
   {
     // if session key on and keys don't match
     // return false, as if nothing was even received
-    if (sessionKeyEnabled() && INCOMING_SESSION_KEY != SESSION_KEY) {
+    if (sessionKeyEnabled() && !SESSION_KEY_ACCEPTED) {			// !RVDB the key was checked against the peer entry by interruptHook()
       interrupts(); // explicitly re-enable interrupts
       receiveBegin();
       return false;
@@ -352,6 +2304,17 @@ _SREG = SREG; 		//  Save Interrupt Control
 #ifdef SREG     	// !RVDB check for AVR environment
     SREG = _SREG; 	// Interrupt Control - Restore interrupts
 #endif   
+#if SESSION_USE_STREAM
+    if (sessionKeyEnabled() && SESSION_STREAM_FRAME && !ACK_RECEIVED)
+    {
+      streamFragment();	// !RVDB stream fragments are reassembled in the stream buffer, not returned to the sketch
+      receiveBegin();
+      return false;
+    }
+#endif
+#if SESSION_USE_ZERO_COPY
+    if (_rxCallback) _rxCallback(SENDERID, receivedData(), receivedLength());
+#endif
     return true;
   }
   else if (_mode == RF69_MODE_RX) // already in RX no payload yet
@@ -384,6 +2347,7 @@ bool RFM69_SessionKey::sessionKeyEnabled() {
 //=============================================================================
 //  ! RVDB New function
 //  useSession3Acks() - Enables 3 ACKS in stead of 1 for final acknowledgement
+//                      (the 2 extra copies only go to the nodes whose ACKs were lost lately)
 //=============================================================================
 void RFM69_SessionKey::useSession3Acks(bool onOff) {
   _session3AcksEnabled = onOff;
@@ -393,11 +2357,12 @@ void RFM69_SessionKey::useSession3Acks(bool onOff) {
 //   session3AcksEnabled() - Check if 3Acks option key is enabled
 //=============================================================================
 bool RFM69_SessionKey::session3AcksEnabled() {
-  return _session3AcksEnabled;
+  return SESSION_USE_3ACKS && _session3AcksEnabled;
 }
 //=============================================================================
 //  ! RVDB New function
 //   sessionWaitTime() - Set the SESSION KEY request response time watchdog
+//                       (upper bound of the timeouts derived from the RTT estimates)
 //=============================================================================
 void RFM69_SessionKey::sessionWaitTime(uint16_t waitTime) {
   if (waitTime == 0) _waitTime = 40;				// if the value is 0 use the default one of 40ms
@@ -405,9 +2370,706 @@ void RFM69_SessionKey::sessionWaitTime(uint16_t waitTime) {
 }
 //=============================================================================
 //  ! RVDB New function
+//  useSessionNextKey() - Enables the next session key piggy-backed on the final ACK
+//=============================================================================
+void RFM69_SessionKey::useSessionNextKey(bool onOff) {
+  _sessionNextKeyEnabled = onOff;
+  SESSION_NEXT_KEY = 0;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionNextKeyEnabled() - Check if the next session key option is enabled
+//=============================================================================
+bool RFM69_SessionKey::sessionNextKeyEnabled() {
+  return _sessionNextKeyEnabled;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionNextKeyTime() - Set the validity time (ms) of a piggy-backed next session key
+//=============================================================================
+void RFM69_SessionKey::sessionNextKeyTime(unsigned long lifeTime) {
+  if (lifeTime < 1000) _nextKeyTime = 1000;				// if the value is too small use the minimum one of 1s
+  else _nextKeyTime = lifeTime;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionBurst() - Allow up to frames frames (1 to 255) within burstTime ms to be sent
+//                    with one session key. Must be the same on both nodes
+//=============================================================================
+void RFM69_SessionKey::sessionBurst(uint8_t frames, uint16_t burstTime) {
+  _burstFrames = frames == 0 ? 1 : frames;				// if the value is 0 use the default one of 1 frame
+  _burstTime = burstTime == 0 ? 1000 : burstTime;		// if the value is 0 use the default one of 1s
+  SESSION_BASE_KEY = 0;
+}
+#if SESSION_USE_MAC
+//=============================================================================
+//  ! RVDB New function
+//   useSessionMac() - Set the 16 byte MAC key (NULL for no MAC), the same on all nodes and best
+//                     different from the encryption key. Its key schedule is done here once: call it
+//                     in setup() after initialize(). The frames with a session key then carry a
+//                     4 byte MAC, and the ones without a valid MAC are refused in the interrupt handler.
+//                     Any node holding the key can send a valid MAC with the ID of another node:
+//                     it authenticates the fleet, not the sender
+//=============================================================================
+void RFM69_SessionKey::useSessionMac(const void* key) {
+  noInterrupts();
+  if (key) _mac.setKey(key);
+  _macEnabled = key != NULL;
+  interrupts();
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionMacEnabled() - Check if the frames with a session key carry a MAC
+//=============================================================================
+bool RFM69_SessionKey::sessionMacEnabled() {
+  return _macEnabled;
+}
+#endif
+#if SESSION_USE_GROUP
+//=============================================================================
+//  ! RVDB New function
+//   useSessionGroup() - Set the group master, the node whose broadcasts are accepted in session mode
+//                       (RF69_BROADCAST_ADDR for none). On the master itself, send(RF69_BROADCAST_ADDR)
+//                       sends repeats copies of a group broadcast numbered from epoch; on the other
+//                       nodes, the broadcasts up to epoch/counter are refused. The broadcasts are only
+//                       accepted with useSessionMac(). The master must not reuse an epoch after a restart:
+//                       keep sessionGroupEpoch() + 1 in EEPROM for the next start. A node keeps its last
+//                       sessionGroupCounter() the same way, else the broadcasts it got before a restart
+//                       are accepted again
+//=============================================================================
+void RFM69_SessionKey::useSessionGroup(uint8_t masterID, uint16_t epoch, uint8_t repeats, uint16_t counter) {
+  noInterrupts();
+  _groupMaster = masterID;
+  _groupRepeats = repeats == 0 ? 1 : repeats;			// if the value is 0 use the default one of 1 copy
+  _groupCounter = (unsigned long)epoch << 16 | counter;
+  interrupts();
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionGroupEpoch() - Return the epoch of the last group broadcast sent or accepted
+//=============================================================================
+uint16_t RFM69_SessionKey::sessionGroupEpoch() {
+  return sessionGroupCounter() >> 16;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionGroupCounter() - Return the epoch (high 16 bits) and counter of the last group broadcast
+//                           sent or accepted, to give back to useSessionGroup() after a restart
+//=============================================================================
+unsigned long RFM69_SessionKey::sessionGroupCounter() {
+  noInterrupts();
+  unsigned long counter = _groupCounter;
+  interrupts();
+  return counter;
+}
+#endif
+#if SESSION_USE_RESUME
+//=============================================================================
+//  ! RVDB New function
+//   useSessionResume() - Ask the gateway for a resume ticket with the next session key request (needs
+//                        useSessionMac): the next frames to it skip the key request and carry the next
+//                        counter of the ticket, checked by their MAC, also after a restart of the gateway
+//=============================================================================
+void RFM69_SessionKey::useSessionResume(bool enabled) {
+  _resumeEnabled = enabled;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionResumeStore() - Give resume tickets to the first count nodes asking (max SESSION_RESUME_MAX_TICKETS),
+//                          in tickets kept by the sketch. The table is saved by write in a store of size bytes
+//                          at address (EEPROM...), one SESSION_RESUME_RECORD_LENGTH(count) bytes slot after
+//                          the other, by sessionResumeFlush(). Call it once at start after useSessionMac(): the
+//                          last table saved is read back and the counters up to its reservations stay
+//                          refused, the nodes resume without a key request. Returns true if a table was
+//                          restored. NULL tickets to give none
+//=============================================================================
+bool RFM69_SessionKey::sessionResumeStore(SessionResume* tickets, uint8_t count, SessionStoreRead read, SessionStoreWrite write, uint16_t address, uint16_t size) {
+  noInterrupts();
+  _resumes = NULL;										// no ticket given nor accepted meanwhile
+  _resumeCount = 0;
+  _resumeDirty = 0;
+  interrupts();
+  if (tickets == NULL || count == 0 || count > SESSION_RESUME_MAX_TICKETS || read == NULL || write == NULL) return false;
+  uint8_t length = SESSION_RESUME_RECORD_LENGTH(count);
+  uint16_t slots = size / length;
+  if (slots == 0) return false;
+  _storeRead = read;
+  _storeWrite = write;
+  _storeAddress = address;
+  _storeSlots = slots < 0x80 ? slots : 0x7F;				// the sequence numbers of the slots stay comparable
+  // !RVDB the last table saved: valid checksum, sequence number above the others
+  uint8_t record[SESSION_RESUME_RECORD_LENGTH(SESSION_RESUME_MAX_TICKETS)];
+  bool found = false;
+  for (uint8_t slot = 0; slot < _storeSlots; slot++)
+  {
+    read(address + (uint16_t)slot * length, record, length);
+    if (resumeChecksum(record, length - 2) != (record[length - 2] | (uint16_t)record[length - 1] << 8)) continue;
+    if (found && (int8_t)(record[0] - _storeSeq) <= 0) continue;
+    found = true;
+    _storeSeq = record[0];
+    _storeSlot = slot;
+  }
+  for (uint8_t i = 0; i < count; i++)
+  {
+    tickets[i].nodeID = RF69_BROADCAST_ADDR;
+    tickets[i].highest = 0;
+    tickets[i].reserved = 0;
+  }
+  if (found)
+  {
+    read(address + (uint16_t)_storeSlot * length, record, length);
+    _resumeEpoch = record[1];
+    for (uint8_t i = 0; i < count; i++)
+    {
+      // !RVDB any counter up to the reservation may have been accepted before the restart
+      tickets[i].nodeID = record[2 + 4 * i];
+      tickets[i].highest = getCounter(record + 3 + 4 * i);
+      tickets[i].reserved = tickets[i].highest;
+    }
+  }
+  else
+  {
+    // !RVDB empty store: a random epoch, the tickets given before the store was lost are most likely refused
+    _storeSeq = 0;
+    _storeSlot = _storeSlots - 1;
+    _resumeEpoch = 1 + (_backoffSeed ^ micros()) % 255;
+  }
+  noInterrupts();
+  _resumes = tickets;
+  _resumeCount = count;
+  interrupts();
+  saveResume(SESSION_RESUME_WINDOW);					// the nodes leap above the restored reservations (resumeFailed)
+  return found;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionResumeFlush() - Save the resume table when a ticket was given or a reservation runs out.
+//                          The store write (a few ms per EEPROM byte changed) is never done by the
+//                          library itself: call it from the loop of the gateway sketch when it can
+//                          wait, a ticket given is only accepted, and a reservation only grows, once
+//                          saved. Returns true if the table was written
+//=============================================================================
+bool RFM69_SessionKey::sessionResumeFlush() {
+  if (!_resumeDirty || _resumes == NULL) return false;
+  saveResume(SESSION_RESUME_BLOCK);
+  return true;
+}
+#endif
+#if SESSION_USE_STREAM
+//=============================================================================
+//  ! RVDB New function
+//   receiveStream() - Set the buffer receiving the next stream, NULL to refuse streams
+//=============================================================================
+void RFM69_SessionKey::receiveStream(void* buffer, uint16_t bufferSize) {
+  noInterrupts();
+  _stream.state = 0;
+  _stream.key = 0;
+  _stream.buffer = (uint8_t*)buffer;
+  _stream.size = bufferSize;
+  interrupts();
+}
+#endif
+#if SESSION_USE_STREAM
+//=============================================================================
+//  ! RVDB New function
+//   streamReceived() - Return the length of the stream received in the receiveStream() buffer,
+//                      once (0 if none). The buffer is then used again for the next stream
+//=============================================================================
+uint16_t RFM69_SessionKey::streamReceived() {
+  if (_stream.state != 2) return 0;
+  _stream.state = 0;									// keep the key to acknowledge repeated fragments
+  return _stream.length;
+}
+#endif
+#if SESSION_USE_STREAM
+//=============================================================================
+//  ! RVDB New function
+//   streamSender() - Return the node the last stream was received from
+//=============================================================================
+uint8_t RFM69_SessionKey::streamSender() {
+  return _stream.nodeID;
+}
+#endif
+//=============================================================================
+//  ! RVDB New function
+//   sessionRtt() - Return the smoothed round trip time (us) to a node, 0 if not measured yet
+//=============================================================================
+uint16_t RFM69_SessionKey::sessionRtt(uint8_t nodeID) {
+  volatile SessionRtt* entry = findRtt(nodeID, false);
+  return entry ? entry->srtt : 0;
+}
+#if SESSION_USE_STATS
+//=============================================================================
+//  ! RVDB New function
+//   sessionStats() - Copy the statistics (consistent copy, taken with interrupts off)
+//=============================================================================
+void RFM69_SessionKey::sessionStats(SessionStats* stats) {
+  noInterrupts();
+  memcpy(stats, (const void*)&_stats, sizeof(SessionStats));
+  interrupts();
+}
+#endif
+#if SESSION_USE_STATS
+//=============================================================================
+//  ! RVDB New function
+//   sessionStatsDump() - Write the statistics in buffer, all values big endian, and
+//                        return the length written (0 if size is too small), one record
+//                        per call so that each one fits a session frame with its MAC:
+//                        SESSION_STATS_GLOBAL, the 10 counters (4 bytes each), 41 bytes, or
+//                        SESSION_STATS_LATENCY, the latency histogram (2 bytes per bucket),
+//                        21 bytes, or
+//                        SESSION_STATS_PEERS, the peerEvictions counter (4 bytes), then per
+//                        known peer its nodeID, handshakes, failures and mismatches (2 bytes
+//                        each), as many as size allows. The peer counters only cover the last
+//                        SESSION_PEER_TABLE_SIZE nodes seen and restart from 0 when a node
+//                        gets an entry again: a rising peerEvictions means they churn
+//=============================================================================
+uint8_t RFM69_SessionKey::sessionStatsDump(uint8_t* buffer, uint8_t size, uint8_t record) {
+  uint8_t length = 0;
+  if (record == SESSION_STATS_GLOBAL)
+  {
+    if (size < 1 + 10 * 4) return 0;
+    SessionStats stats;
+    sessionStats(&stats);
+    uint32_t counters[10] = {stats.handshakesStarted, stats.handshakesCompleted, stats.keyTimeouts,
+                             stats.keysIssued, stats.keyMismatches, stats.framesAccepted,
+                             stats.ackTimeouts, stats.ackRepeats, stats.csmaWaits, stats.keysRefused};
+    buffer[length++] = SESSION_STATS_GLOBAL;
+    for (uint8_t i = 0; i < 10; i++)
+    {
+      buffer[length++] = counters[i] >> 24;
+      buffer[length++] = counters[i] >> 16;
+      buffer[length++] = counters[i] >> 8;
+      buffer[length++] = counters[i];
+    }
+    return length;
+  }
+  if (record == SESSION_STATS_LATENCY)
+  {
+    if (size < 1 + SESSION_STATS_BUCKETS * 2) return 0;
+    SessionStats stats;
+    sessionStats(&stats);
+    buffer[length++] = SESSION_STATS_LATENCY;
+    for (uint8_t i = 0; i < SESSION_STATS_BUCKETS; i++)
+    {
+      buffer[length++] = stats.latency[i] >> 8;
+      buffer[length++] = stats.latency[i];
+    }
+    return length;
+  }
+  if (record != SESSION_STATS_PEERS || size < 5) return 0;
+  noInterrupts();
+  uint32_t evictions = _stats.peerEvictions;
+  interrupts();
+  buffer[length++] = SESSION_STATS_PEERS;
+  buffer[length++] = evictions >> 24;
+  buffer[length++] = evictions >> 16;
+  buffer[length++] = evictions >> 8;
+  buffer[length++] = evictions;
+  for (uint8_t i = 0; i < SESSION_PEER_TABLE_SIZE && length + 7 <= size; i++)
+  {
+    noInterrupts();
+    SessionRtt entry;
+    memcpy(&entry, (const void*)&_rtt[i], sizeof(SessionRtt));
+    interrupts();
+    if (entry.nodeID == RF69_BROADCAST_ADDR) continue;
+    buffer[length++] = entry.nodeID;
+    buffer[length++] = entry.handshakes >> 8;
+    buffer[length++] = entry.handshakes;
+    buffer[length++] = entry.failures >> 8;
+    buffer[length++] = entry.failures;
+    buffer[length++] = entry.mismatches >> 8;
+    buffer[length++] = entry.mismatches;
+  }
+  return length;
+}
+#endif
+#if SESSION_USE_TRACE
+//=============================================================================
+//  ! RVDB New function
+//   useSessionTrace() - Start or stop recording the events in the trace ring (started by
+//                       initialize): stop it when a failure is seen, so that the events
+//                       leading to it are still in the ring when it is dumped
+//=============================================================================
+void RFM69_SessionKey::useSessionTrace(bool enabled) {
+  _traceEnabled = enabled;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sessionTraceDump() - Write the trace ring in buffer, all values big endian, and return
+//                        the length written (0 if size is too small): 'S', 'T',
+//                        SESSION_TRACE_FORMAT, our node ID, the events recorded (2 bytes,
+//                        wraps to SESSION_TRACE_SIZE), micros() now (4 bytes), the number
+//                        of entries, then the newest entries oldest first, as many as size
+//                        allows: time (4 bytes), event, CTL, peer, status, key (4 bytes).
+//                        The interrupts are off while the ring is copied. Decoded on the
+//                        host by extras/SessionTrace
+//=============================================================================
+uint16_t RFM69_SessionKey::sessionTraceDump(uint8_t* buffer, uint16_t size, bool clear) {
+  if (size < SESSION_TRACE_HEADER) return 0;
+  uint32_t now = micros();
+  noInterrupts();
+  uint16_t count = _traceCount;
+  uint8_t entries = count < SESSION_TRACE_SIZE ? count : SESSION_TRACE_SIZE;
+  if (entries > (size - SESSION_TRACE_HEADER) / SESSION_TRACE_ENTRY) entries = (size - SESSION_TRACE_HEADER) / SESSION_TRACE_ENTRY;
+  uint16_t length = 0;
+  buffer[length++] = 'S';
+  buffer[length++] = 'T';
+  buffer[length++] = SESSION_TRACE_FORMAT;
+  buffer[length++] = _address;
+  buffer[length++] = count >> 8;
+  buffer[length++] = count;
+  buffer[length++] = now >> 24;
+  buffer[length++] = now >> 16;
+  buffer[length++] = now >> 8;
+  buffer[length++] = now;
+  buffer[length++] = entries;
+  for (uint8_t i = 0; i < entries; i++)
+  {
+    volatile SessionTraceEntry* entry = &_trace[(count - entries + i) & (SESSION_TRACE_SIZE - 1)];
+    buffer[length++] = entry->time >> 24;
+    buffer[length++] = entry->time >> 16;
+    buffer[length++] = entry->time >> 8;
+    buffer[length++] = entry->time;
+    buffer[length++] = entry->event;
+    buffer[length++] = entry->ctl;
+    buffer[length++] = entry->peer;
+    buffer[length++] = entry->status;
+    buffer[length++] = entry->key >> 24;
+    buffer[length++] = entry->key >> 16;
+    buffer[length++] = entry->key >> 8;
+    buffer[length++] = entry->key;
+  }
+  if (clear) _traceCount = 0;
+  interrupts();
+  return length;
+}
+#endif
+#if SESSION_USE_RX_QUEUE
+//=============================================================================
+//  ! RVDB New function
+//   receiveQueue() - Set the slots of the receive queue (depth frames), NULL to stop
+//                    queueing: the frames are then received with receiveDone() only
+//=============================================================================
+void RFM69_SessionKey::receiveQueue(SessionFrame* slots, uint8_t depth) {
+  noInterrupts();
+  _queue = depth ? slots : NULL;
+  _queueDepth = slots ? depth : 0;
+  _queueHead = 0;
+  _queueCount = 0;
+  interrupts();
+}
+#endif
+#if SESSION_USE_RX_QUEUE
+//=============================================================================
+//  ! RVDB New function
+//   receiveQueued() - Copy the oldest frame of the receive queue to frame and free its
+//                     slot. Returns false if the queue is empty. The frame ACK (when its
+//                     ctl has RFM69_CTL_REQACK) is sent with sendQueuedACK()
+//=============================================================================
+bool RFM69_SessionKey::receiveQueued(SessionFrame* frame) {
+  if (_queueCount == 0)
+  {
+    receiveDone();										// !RVDB make sure the radio is receiving (a frame left in DATA is for the send functions)
+    return false;
+  }
+  noInterrupts();
+  memcpy(frame, &_queue[_queueHead], sizeof(SessionFrame));
+  _queueHead = _queueHead + 1 < _queueDepth ? _queueHead + 1 : 0;
+  _queueCount--;
+  interrupts();
+  return true;
+}
+#endif
+#if SESSION_USE_RX_QUEUE
+//=============================================================================
+//  ! RVDB New function
+//   queuedFrames() - Return the number of frames waiting in the receive queue
+//=============================================================================
+uint8_t RFM69_SessionKey::queuedFrames() {
+  return _queueCount;
+}
+#endif
+#if SESSION_USE_RX_QUEUE
+//=============================================================================
+//  ! RVDB New function
+//   queueDrops() - Return the number of frames dropped because the receive queue was full
+//=============================================================================
+uint32_t RFM69_SessionKey::queueDrops() {
+  noInterrupts();
+  uint32_t drops = _queueDrops;
+  interrupts();
+  return drops;
+}
+#endif
+//=============================================================================
+//  ! RVDB New function
+//   fifoLoadTime() - Return the time (us) the last frame took from the start of
+//                    startFrame() to its last byte loaded in the FIFO (including _respDelayTime)
+//=============================================================================
+uint16_t RFM69_SessionKey::fifoLoadTime() {
+  return _fifoLoadTime;
+}
+//=============================================================================
+//  ! RVDB New function
+//   keyResponseLoadTime() - Return the time (us) the last session key response took from
+//                           the request in interruptHook() to its last byte loaded in the FIFO
+//=============================================================================
+uint16_t RFM69_SessionKey::keyResponseLoadTime() {
+  return _keyResponseLoadTime;
+}
+//=============================================================================
+//  ! RVDB New function
+//   handshakeTime() - Return the time (us) from the last session key request sent (its last
+//                     byte on air) to its session key received, the handshake wait of the sender
+//=============================================================================
+uint16_t RFM69_SessionKey::handshakeTime() {
+  return _handshakeTime;
+}
+//=============================================================================
+//  ! RVDB New function
+//   ackTime() - Return the time (us) from the last frame sent (its last byte on air) to its
+//               ACK received, the ACK wait of the sender
+//=============================================================================
+uint16_t RFM69_SessionKey::ackTime() {
+  return _ackTime;
+}
+//=============================================================================
+//  ! RVDB New function
+//   isrTime() - Return the longest interrupt handler duration (us) since the last call
+//=============================================================================
+uint16_t RFM69_SessionKey::isrTime() {
+  noInterrupts();
+  uint16_t time = _isrTime;
+  _isrTime = 0;
+  interrupts();
+  return time;
+}
+#if SESSION_USE_ASYNC_SEND
+//=============================================================================
+//  ! RVDB New function
+//   sendStatus() - Return the state of the non-blocking send (SESSION_SEND_xxx)
+//=============================================================================
+uint8_t RFM69_SessionKey::sendStatus() {
+  return _sendState;
+}
+#endif
+#if SESSION_USE_ASYNC_SEND
+//=============================================================================
+//  ! RVDB New function
+//   onSendDone() - Set the function called by poll() when the non-blocking send is over
+//=============================================================================
+void RFM69_SessionKey::onSendDone(SessionSendCallback callback) {
+  _sendDone = callback;
+}
+#endif
+//=============================================================================
+//  ! RVDB New function
 //   sessionRespDelay() - Set the SESSION KEY response delay for slow remote node
+//                        (lower bound of the delay adapted per node to lost responses)
 //=============================================================================
 void RFM69_SessionKey::sessionRespDelayTime(uint16_t respDelayTime) {
   if (respDelayTime > 500) _respDelayTime = 500;				// if the value is 0 use the maximum one of 500us
   else _respDelayTime = respDelayTime;
-}
\ No newline at end of file
+}
+#if SESSION_USE_ZERO_COPY
+//=============================================================================
+//  ! RVDB New function
+//   receiveBuffer() - Set the buffer the interrupt handler reads the payload in, instead of DATA
+//                     (NULL to go back to DATA). The payload stays there until the next
+//                     receiveDone(), read it with receivedData() and receivedLength()
+//=============================================================================
+void RFM69_SessionKey::receiveBuffer(void* buffer, uint8_t bufferSize) {
+  noInterrupts();
+  _rxBuffer = (uint8_t*)buffer;
+  _rxSize = buffer ? bufferSize : 0;
+  _rxLength = 0;
+  interrupts();
+}
+//=============================================================================
+//  ! RVDB New function
+//   onReceive() - Set the function receiveDone() calls with each payload received, before
+//                 returning true (NULL for none)
+//=============================================================================
+void RFM69_SessionKey::onReceive(SessionReceiveCallback callback) {
+  _rxCallback = callback;
+}
+#endif
+//=============================================================================
+//  ! RVDB New function
+//   receivedData() - Return the payload received: the receive buffer if any, else DATA
+//=============================================================================
+const uint8_t* RFM69_SessionKey::receivedData() {
+#if SESSION_USE_ZERO_COPY
+  if (_rxBuffer) return _rxBuffer;
+#endif
+  return (const uint8_t*)DATA;
+}
+//=============================================================================
+//  ! RVDB New function
+//   receivedLength() - Return the length of the payload received
+//=============================================================================
+uint8_t RFM69_SessionKey::receivedLength() {
+#if SESSION_USE_ZERO_COPY
+  if (_rxBuffer) return _rxLength;
+#endif
+  return DATALEN;
+}
+#if SESSION_USE_RECORDS
+//=============================================================================
+//  ! RVDB New function
+//   recordBuffers() - Set the buffers the records are packed in, one per destination node (NULL for none).
+//                     A buffer is sent with sendWithRetry(retries) when the next record doesn't fit,
+//                     or by flushRecords() once its oldest record waited deadline ms
+//=============================================================================
+void RFM69_SessionKey::recordBuffers(SessionRecordBuffer* buffers, uint8_t count, uint16_t deadline, uint8_t retries) {
+  _records = buffers;
+  _recordCount = buffers ? count : 0;
+  _recordDeadline = deadline;
+  _recordRetries = retries;
+  for (uint8_t i = 0; i < _recordCount; i++)
+  {
+    _records[i].toAddress = RF69_BROADCAST_ADDR;
+    _records[i].length = 0;
+  }
+}
+//=============================================================================
+//  ! RVDB New function
+//   sendRecord() - Add a record (type chosen by the sketch, up to SESSION_RECORD_MAX_LEN bytes) to the
+//                  frame to toAddress. A full buffer, or the oldest one when none is free, is sent first.
+//                  Returns false if the record can't be added, or the frame sent first was not acknowledged
+//=============================================================================
+bool RFM69_SessionKey::sendRecord(uint8_t toAddress, uint8_t type, const void* data, uint8_t length) {
+  if (_records == NULL || length > SESSION_RECORD_MAX_LEN || toAddress == RF69_BROADCAST_ADDR) return false;
+  SessionRecordBuffer* buffer = NULL;
+  SessionRecordBuffer* oldest = &_records[0];			// a free buffer, else the one waiting the longest
+  for (uint8_t i = 0; i < _recordCount && buffer == NULL; i++)
+  {
+    if (_records[i].toAddress == toAddress) buffer = &_records[i];
+    else if (oldest->toAddress == RF69_BROADCAST_ADDR) continue;
+    else if (_records[i].toAddress == RF69_BROADCAST_ADDR ||
+             (int32_t)(_records[i].firstTime - oldest->firstTime) < 0) oldest = &_records[i];
+  }
+  bool sent = true;
+  if (buffer && buffer->length + SESSION_RECORD_HEADER_LENGTH + length > SESSION_MAX_DATA_LEN) sent = sendRecordBuffer(buffer);
+  if (buffer == NULL)
+  {
+    buffer = oldest;
+    if (buffer->toAddress != RF69_BROADCAST_ADDR) sent = sendRecordBuffer(buffer);
+  }
+  if (buffer->length == 0)
+  {
+    buffer->toAddress = toAddress;
+    buffer->firstTime = millis();
+  }
+  buffer->data[buffer->length++] = type;
+  buffer->data[buffer->length++] = length;
+  memcpy(buffer->data + buffer->length, data, length);
+  buffer->length += length;
+  return sent;
+}
+//=============================================================================
+//  ! RVDB New function
+//   flushRecords() - Send the record buffers whose oldest record waited the deadline, or all of them.
+//                    Call it from loop(). Returns false if a frame was not acknowledged (its records are dropped)
+//=============================================================================
+bool RFM69_SessionKey::flushRecords(bool all) {
+  bool sent = true;
+  for (uint8_t i = 0; i < _recordCount; i++)
+  {
+    SessionRecordBuffer* buffer = &_records[i];
+    if (buffer->toAddress == RF69_BROADCAST_ADDR) continue;
+    if (all || millis() - buffer->firstTime >= _recordDeadline)
+      if (!sendRecordBuffer(buffer)) sent = false;
+  }
+  return sent;
+}
+//=============================================================================
+//  ! RVDB New function
+//   sendRecordBuffer() - Send the records of a buffer as one frame flagged SESSION_CTL_RECORDS, and free it
+//=============================================================================
+bool RFM69_SessionKey::sendRecordBuffer(SessionRecordBuffer* buffer) {
+  bool sent = retrySend(buffer->toAddress, buffer->data, buffer->length, _recordRetries, _waitTime, SESSION_CTL_RECORDS);
+  buffer->toAddress = RF69_BROADCAST_ADDR;
+  buffer->length = 0;
+  return sent;
+}
+//=============================================================================
+//  ! RVDB New function
+//   recordsReceived() - Check if the payload received is made of records, read them with nextRecord()
+//=============================================================================
+bool RFM69_SessionKey::recordsReceived() {
+  return SESSION_RECORDS_FRAME;
+}
+//=============================================================================
+//  ! RVDB New function
+//   nextRecord() - Return the next record of the payload received (receivedData()), data points in
+//                  the payload. Returns false after the last record, or if the payload is not made of records
+//=============================================================================
+bool RFM69_SessionKey::nextRecord(uint8_t* type, const uint8_t** data, uint8_t* length) {
+  if (!SESSION_RECORDS_FRAME) return false;
+  return nextRecord(receivedData(), receivedLength(), &_recordOffset, type, data, length);
+}
+//=============================================================================
+//  ! RVDB New function
+//   nextRecord() - Return the record of payload at *offset and move *offset to the next one (start with 0),
+//                  for the payload of a queued frame (ctl & SESSION_CTL_RECORDS). Returns false after
+//                  the last record, or on a record running past the payload end
+//=============================================================================
+bool RFM69_SessionKey::nextRecord(const uint8_t* payload, uint8_t payloadLength, uint8_t* offset, uint8_t* type, const uint8_t** data, uint8_t* length) {
+  if (*offset + SESSION_RECORD_HEADER_LENGTH > payloadLength) return false;
+  uint8_t size = payload[*offset + 1];
+  if (*offset + SESSION_RECORD_HEADER_LENGTH + size > payloadLength) return false;
+  *type = payload[*offset];
+  *length = size;
+  *data = payload + *offset + SESSION_RECORD_HEADER_LENGTH;
+  *offset += SESSION_RECORD_HEADER_LENGTH + size;
+  return true;
+}
+#endif
+//=============================================================================
+//  ! RVDB New function
+//   sessionBackoff() - Set the random backoff slot (ms, 0 to send as soon as the channel is free)
+//                      and the largest backoff window (2^maxExponent slots, up to 8)
+//=============================================================================
+void RFM69_SessionKey::sessionBackoff(uint8_t slotTime, uint8_t maxExponent) {
+  _backoffSlot = slotTime;
+  _backoffMax = maxExponent > 8 ? 8 : maxExponent;			// keeps the window below 65536ms
+}
+#if SESSION_USE_TX_QUEUE
+//=============================================================================
+//  ! RVDB New function
+//   sendQueue() - Set the slots of the send queue, NULL for none. poll() sends the queued frames
+//                 one at a time, the oldest of the highest priority first (onSendDone() tells
+//                 the result of each one)
+//=============================================================================
+void RFM69_SessionKey::sendQueue(SessionTxFrame* slots, uint8_t depth) {
+  _txQueue = slots;
+  _txDepth = slots ? depth : 0;
+  _txCount = 0;
+}
+//=============================================================================
+//  ! RVDB New function
+//   queueSend() - Queue a frame for poll(), with its beginSend() parameters and a priority
+//                 (SESSION_PRIORITY_xxx). Returns false when the send queue is full
+//=============================================================================
+bool RFM69_SessionKey::queueSend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, uint8_t retries, uint8_t priority) {
+  if (_txCount == _txDepth || toAddress == RF69_BROADCAST_ADDR) return false;
+  if (bufferSize > SESSION_MAX_DATA_LEN) bufferSize = SESSION_MAX_DATA_LEN;
+  SessionTxFrame* frame = &_txQueue[_txCount++];
+  frame->toAddress = toAddress;
+  frame->priority = priority;
+  frame->requestACK = requestACK;
+  frame->retries = retries;
+  frame->length = bufferSize;
+  memcpy(frame->data, buffer, bufferSize);
+  return true;
+}
+//=============================================================================
+//  ! RVDB New function
+//   queuedSends() - Return the number of frames in the send queue
+//=============================================================================
+uint8_t RFM69_SessionKey::queuedSends() {
+  return _txCount;
+}
+#endif
\ No newline at end of file
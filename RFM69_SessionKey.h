@@ -25,6 +25,59 @@
 //  12. Correct typo in RFM69_SessionKey::initialise instead of RFM69_SessionKey::initialize
 //  13. Improve messages of 9.
 //	14. Correct restore Interrupt in receiveDone() function for ESP8266 compatibilities 
+//  15. Issued session keys are kept per peer (SENDERID) in a small table with an expiry (SESSION_PEER_TABLE_SIZE),
+//      so a key request from one node no longer overwrites the session in flight with another node
+//  16. New functions (useSessionNextKey, sessionNextKeyTime): the final ACK carries the key of the next session,
+//      so the next send to the same node can skip the session key request
+//  17. New function (sessionBurst): one session key can be used for up to N frames within T ms, each frame carrying
+//      the key plus a rolling counter checked against a 32 frames replay window
+//  18. New functions (sendStream, receiveStream, streamReceived): buffers larger than SESSION_MAX_DATA_LEN are sent
+//      as fragments under one session key, a window of fragments at a time, with a selective ACK of the received ones
+//  19. New functions (beginSend, poll, sendStatus, onSendDone): non-blocking send, the session key request, the
+//      transmission and the ACK wait are advanced by poll() instead of busy-waiting
+//  20. The FIFO is written (header, session key, payload) and the session key read with one block SPI transfer,
+//      new functions (fifoLoadTime, keyResponseLoadTime) return the FIFO load time in us, (handshakeTime, ackTime)
+//      the last wait for a session key and for an ACK in us
+//  21. The handshake round trip time is estimated per peer (smoothed RTT and variance), the session key and ACK
+//      timeouts are derived from it with sessionWaitTime() as upper bound (new function sessionRtt), the key
+//      response delay grows when responses to a peer are lost, with sessionRespDelayTime() as lower bound
+//  22. New functions (sessionStats, sessionStatsDump): counters of handshakes, key mismatches, timeouts, ACK repeats
+//      and CSMA waits, a log2 histogram of the handshake latency and per peer counters, updated in the interrupt handler.
+//      The per peer counters only cover the last SESSION_PEER_TABLE_SIZE nodes heard, and restart from 0 when an evicted node is heard again
+//  23. New functions (receiveQueue, receiveQueued, queuedFrames, queueDrops, sendQueuedACK): the interrupt handler
+//      stores the validated frames in a queue of sketch provided slots and goes straight back to receive mode
+//  24. The interrupt handler no longer waits for the session key response to be sent: the request is queued, the
+//      response started at once when the radio is free (else by receiveDone() or the new function sessionService())
+//      and ended by the "packet sent" interrupt, new function isrTime (longest interrupt handler us)
+//  25. Compile time options (SESSION_USE_xxx) to leave the unused features out of small AVR nodes
+//  26. New functions (useSessionGroup, sessionGroupEpoch, sessionGroupCounter): in session mode, a broadcast of the
+//      group master is sent once to all nodes with an epoch/counter and a MAC, accepted by the nodes when above the
+//      last one received. The counter does not run into the next epoch, kept by the master for its next start
+//  27. Host side network simulator (extras/SessionSim): one gateway and N nodes running this library on the host
+//      backend (extras/SessionHost, simulated RFM69 and channel), prints the delivery ratio, handshake success,
+//      key mismatch rate and latency distribution per node count
+//  28. Random exponential backoff when the channel becomes free and before a retry (new function sessionBackoff),
+//      new functions (sendQueue, queueSend, queuedSends): frames sent by poll() in priority order
+//  29. New functions (receiveBuffer, receivedData, receivedLength, onReceive): the interrupt handler reads the payload
+//      from the FIFO straight into a sketch buffer, the sketch gets a view of it instead of copying DATA
+//  30. New functions (recordBuffers, sendRecord, flushRecords, recordsReceived, nextRecord): small records are packed
+//      per destination in one session frame, sent when full or after a deadline
+//  31. New functions (useSessionMac, sessionMacEnabled): frames with a session key carry a 32-bit MAC (Chaskey, see
+//      RFM69_SessionMac.h) over header, key(s) and payload, checked in the interrupt handler before the key.
+//      Host benchmark of the MAC in extras/SessionMacBench. The MAC key is shared by the fleet: the MAC tells a
+//      frame of the fleet from a forged one, not one node from another. The session keys are no longer millis()
+//      but random (xorshift mixed with micros()), two peers served in the same ms get different keys
+//  32. A frame whose ACK timed out is sent once again with the same session key: the receiver keeps the key of the
+//      last ACK sent to each node and answers such a duplicate with the ACK again, without giving it twice to the
+//      sketch. useSession3Acks() now sends the extra ACK copies only to the nodes whose ACKs were lost lately
+//  33. New functions (useSessionResume, sessionResumeStore, sessionResumeFlush): a gateway gives resume tickets to the
+//      nodes, their frames then carry a counter of the ticket instead of a requested key (no key request round trip). The
+//      gateway sketch saves the ticket counters in blocks to a store (EEPROM) in turn over its slots with
+//      sessionResumeFlush(), so the tickets stay valid after a restart (the nodes do not get through a restart faster
+//      than with a handshake)
+//  34. New functions (useSessionTrace, sessionTraceDump): with SESSION_USE_TRACE, the frames sent and received and the
+//      timeouts are recorded in a RAM ring (time, event, CTL, peer, key, status) dumped as one binary blob, decoded on
+//      the host by extras/SessionTrace into a timeline or a pcap file
 // **********************************************************************************
 // Session key class derived from RFM69 library. Session key prevents replay of wireless transmissions.
 
@@ -59,10 +112,304 @@
 #define RFM69_SessionKey_h
 #include <RFM69.h>
 
+// !RVDB Compile time options: set one to 0 to leave the feature out and save its flash and RAM. The
+// functions of a feature left out are not declared. Set them here, in this file: the Arduino IDE
+// compiles RFM69_SessionKey.cpp on its own, a #define in the sketch before the #include would only
+// change the class seen by the sketch. A -D build flag is fine when it applies to the whole build
+// (PlatformIO build_flags, arduino-cli --build-property). A sketch built with other options than
+// the library fails to link, with an undefined sessionConfig_xxx function (see SESSION_CONFIG)
+// Bytes saved on an ATmega328 (library objects, clang -Os, default options: 27308 flash, 747 RAM):
+//   3ACKS 300/16, RESP_DELAY 482/16, PROMISCUOUS 32/0, STREAM 2930/28, ASYNC_SEND 2624/80 (with TX_QUEUE),
+//   TX_QUEUE 420/4, STATS 2088/108, RX_QUEUE 630/10, ZERO_COPY 352/6, RECORDS 1438/8, GROUP 556/6,
+//   MAC 6820/105 (with RESUME), RESUME 4328/25. TRACE set to 1 costs 1500/393. All off: 9584 flash, 361 RAM
+//   Not representative of an Arduino build: measured with the LLVM AVR backend, not avr-gcc, before
+//   --gc-sections. Only compare the options with each other
+#ifndef SESSION_USE_3ACKS
+#define SESSION_USE_3ACKS		1												// 3 final ACKs (useSession3Acks)
+#endif
+#ifndef SESSION_USE_RESP_DELAY
+#define SESSION_USE_RESP_DELAY	1												// session key response delay (sessionRespDelayTime)
+#endif
+#ifndef SESSION_USE_PROMISCUOUS
+#define SESSION_USE_PROMISCUOUS	1												// ignore the received frames in promiscuous mode
+#endif
+#ifndef SESSION_USE_STREAM
+#define SESSION_USE_STREAM		1												// sendStream, receiveStream
+#endif
+#ifndef SESSION_USE_ASYNC_SEND
+#define SESSION_USE_ASYNC_SEND	1												// beginSend, poll
+#endif
+#ifndef SESSION_USE_TX_QUEUE
+#define SESSION_USE_TX_QUEUE	SESSION_USE_ASYNC_SEND							// sendQueue, queueSend (needs SESSION_USE_ASYNC_SEND)
+#endif
+#ifndef SESSION_USE_STATS
+#define SESSION_USE_STATS		1												// sessionStats, sessionStatsDump
+#endif
+#ifndef SESSION_USE_RX_QUEUE
+#define SESSION_USE_RX_QUEUE	1												// receiveQueue, receiveQueued
+#endif
+#ifndef SESSION_USE_ZERO_COPY
+#define SESSION_USE_ZERO_COPY	1												// receiveBuffer, onReceive
+#endif
+#ifndef SESSION_USE_RECORDS
+#define SESSION_USE_RECORDS		1												// recordBuffers, sendRecord, nextRecord
+#endif
+#ifndef SESSION_USE_MAC
+#define SESSION_USE_MAC			1												// message authentication code (useSessionMac), 4 bytes of each frame
+#endif
+#ifndef SESSION_USE_GROUP
+#define SESSION_USE_GROUP		SESSION_USE_MAC									// broadcasts with a group epoch (useSessionGroup, needs SESSION_USE_MAC)
+#endif
+#ifndef SESSION_USE_RESUME
+#define SESSION_USE_RESUME		SESSION_USE_MAC									// resume tickets kept across a restart (useSessionResume, needs SESSION_USE_MAC)
+#endif
+#ifndef SESSION_USE_TRACE
+#define SESSION_USE_TRACE		0												// trace ring of the frames (useSessionTrace, sessionTraceDump), off: SESSION_TRACE_SIZE * 12 bytes of RAM
+#endif
+#ifndef SESSION_TRACE_SIZE
+#define SESSION_TRACE_SIZE		32												// trace ring entries (power of 2, max 128)
+#endif
+// !RVDB name of a function encoding the options, defined by RFM69_SessionKey.cpp and called by the constructor
+#define SESSION_CONFIG_NAME(a, b, c, d, e, f, g, h, i, j, k, l, m, n, size) sessionConfig_##a##b##c##d##e##f##g##h##i##j##k##l##m##n##_##size
+#define SESSION_CONFIG_EXPAND(a, b, c, d, e, f, g, h, i, j, k, l, m, n, size) SESSION_CONFIG_NAME(a, b, c, d, e, f, g, h, i, j, k, l, m, n, size)
+#define SESSION_CONFIG			SESSION_CONFIG_EXPAND(SESSION_USE_3ACKS, SESSION_USE_RESP_DELAY, SESSION_USE_PROMISCUOUS, \
+								SESSION_USE_STREAM, SESSION_USE_ASYNC_SEND, SESSION_USE_TX_QUEUE, SESSION_USE_STATS, \
+								SESSION_USE_RX_QUEUE, SESSION_USE_ZERO_COPY, SESSION_USE_RECORDS, SESSION_USE_GROUP, \
+								SESSION_USE_MAC, SESSION_USE_RESUME, SESSION_USE_TRACE, SESSION_TRACE_SIZE)
+void SESSION_CONFIG();
+#if SESSION_USE_MAC
+#include "RFM69_SessionMac.h"
+#define SESSION_MAC_LENGTH		4												// !RVDB bytes of the truncated MAC at the end of a frame
+#else
+#define SESSION_MAC_LENGTH		0
+#endif
+
 #define SESSION_KEY_LENGTH	4										  		// !RVDB define to the session key Length
 #define RF69_HEADER_LENGTH  4 												// !RVDB define to the RFM standard Header Length
 #define SESSION_HEADER_LENGTH	RF69_HEADER_LENGTH + SESSION_KEY_LENGTH	    // !RVDB define to the session Header Length (including RF69_HEADER_LENGTH)
-#define SESSION_MAX_DATA_LEN 	RF69_MAX_DATA_LEN - SESSION_KEY_LENGTH		// !RVDB Define the Session maximum Data Length
+#define SESSION_MAX_DATA_LEN 	(RF69_MAX_DATA_LEN - SESSION_KEY_LENGTH - SESSION_MAC_LENGTH) // !RVDB Define the Session maximum Data Length (room left for the MAC)
+#ifndef SESSION_PEER_TABLE_SIZE
+#define SESSION_PEER_TABLE_SIZE	8											// !RVDB number of peers able to hold a session at the same time, and with an RTT estimate and per peer counters (power of 2)
+#endif
+#define SESSION_CTL_STREAM		0x08											// !RVDB flag in CTL byte indicating a stream fragment or its selective ACK
+#define SESSION_CTL_GROUP		0x04											// !RVDB flag in CTL byte indicating a group broadcast or a resume frame (epoch/counter in the key bytes)
+#define SESSION_CTL_RECORDS		0x02											// !RVDB flag in CTL byte indicating a payload of records (type, length, data)
+#define SESSION_CTL_MAC			0x01											// !RVDB flag in CTL byte indicating a MAC at the end of the frame
+#define SESSION_CTL_MASK		(SESSION_CTL_STREAM | SESSION_CTL_GROUP | SESSION_CTL_RECORDS | SESSION_CTL_MAC) // !RVDB CTL bits used by this library on top of the RFM69 ones
+#define SESSION_STREAM_HEADER_LENGTH 4											// !RVDB fragment index and stream length (2 bytes each) in front of each fragment
+#define SESSION_STREAM_DATA_LEN	(SESSION_MAX_DATA_LEN - SESSION_STREAM_HEADER_LENGTH) // !RVDB stream bytes carried by one fragment
+#define SESSION_RECORD_HEADER_LENGTH 2											// !RVDB type and length in front of each record
+#define SESSION_RECORD_MAX_LEN	(SESSION_MAX_DATA_LEN - SESSION_RECORD_HEADER_LENGTH) // !RVDB largest record
+
+#ifndef SESSION_REPLY_QUEUE_SIZE
+#define SESSION_REPLY_QUEUE_SIZE 4												// !RVDB session key responses waiting for sessionService()
+#endif
+#define SESSION_MIN_WAIT_TIME	5												// !RVDB lower bound (ms) of the timeouts derived from the RTT estimate
+#define SESSION_MAX_RESP_DELAY	500												// !RVDB upper bound (us) of the session key response delay
+#define SESSION_BACKOFF_SLOT	4												// !RVDB default backoff slot (ms), about the air time of a key request and its response
+#define SESSION_BACKOFF_MAX		5												// !RVDB default largest backoff window, 2^5 slots
+#define SESSION_ACK_COPIES_MAX	2												// !RVDB ACK copies sent on top of the first one to a lossy node (useSession3Acks)
+#define SESSION_ACK_DECAY		16												// !RVDB ACKs without loss before one ACK copy less
+#define SESSION_RESUME_BLOCK	32												// !RVDB resume counters reserved by each write to the store
+#define SESSION_RESUME_WINDOW	(4 * SESSION_RESUME_BLOCK)						// !RVDB resume counters reserved at restart, above the restored reservations
+#define SESSION_RESUME_FAILURES	8												// !RVDB sends without answer before a node drops its resume ticket
+#define SESSION_RESUME_COUNTER	0xFFFFFFUL										// !RVDB counter bits of a resume key, the high byte is the epoch
+#define SESSION_RESUME_MAX_TICKETS 32											// !RVDB largest resume table (sessionResumeStore)
+#define SESSION_RESUME_RECORD_LENGTH(count) (4 + 4 * (count))					// !RVDB bytes of a saved resume table: sequence, epoch, tickets, checksum
+
+// !RVDB frames queued by the interrupt handler for sessionService()
+#define SESSION_REPLY_KEY		0												// session key response
+#define SESSION_REPLY_TICKET	1												// session key response carrying a resume ticket
+#define SESSION_REPLY_ACK		2												// ACK of a duplicate frame (its first ACK was lost)
+#define SESSION_REPLY_RESYNC	3												// counter to resume from (0: no ticket) for a refused resume frame
+#define SESSION_REPLY_SACK		4												// selective ACK of the stream being received
+
+// !RVDB queueSend() priorities, a lower value is sent first
+#define SESSION_PRIORITY_HIGH	0
+#define SESSION_PRIORITY_NORMAL	1
+#define SESSION_PRIORITY_BULK	2
+
+#define SESSION_STATS_BUCKETS	10												// !RVDB handshake latency histogram: < 1ms, then one bucket per doubling
+#define SESSION_STATS_FIRST_BUCKET 10											// !RVDB log2 (us) of the upper bound of the first histogram bucket
+#define SESSION_STATS_GLOBAL	1												// !RVDB first byte of sessionStatsDump() with the global counters
+#define SESSION_STATS_PEERS		2												// !RVDB first byte of sessionStatsDump() with the per peer counters
+#define SESSION_STATS_LATENCY	3												// !RVDB first byte of sessionStatsDump() with the latency histogram
+
+// !RVDB trace events (sessionTraceDump), the meaning of the status byte depends on the event
+#define SESSION_TRACE_TX		1												// frame loaded in the FIFO, status: payload bytes
+#define SESSION_TRACE_RX		2												// frame received, status: SESSION_TRACE_PLAIN to SESSION_TRACE_RESYNC
+#define SESSION_TRACE_TIMEOUT	3												// no answer in time, status: SESSION_SEND_KEY_WAIT or SESSION_SEND_ACK_WAIT
+#define SESSION_TRACE_PLAIN		1												// received without session key check
+#define SESSION_TRACE_ACCEPTED	2												// received with the expected session key
+#define SESSION_TRACE_REFUSED	3												// unexpected key, forged, or no room for the answer
+#define SESSION_TRACE_REPLY		4												// answered by sessionService(): key response, ACK again or resync
+#define SESSION_TRACE_KEY		5												// session key response to our request
+#define SESSION_TRACE_RESYNC	6												// resync answer to our resume frame
+#define SESSION_TRACE_FORMAT	1												// !RVDB third byte of sessionTraceDump(), after 'S' 'T'
+#define SESSION_TRACE_HEADER	11												// !RVDB bytes of sessionTraceDump() before the entries
+#define SESSION_TRACE_ENTRY		12												// !RVDB bytes of each entry in sessionTraceDump()
+
+// !RVDB sendStatus() values of a non-blocking send (beginSend)
+#define SESSION_SEND_IDLE		0												// no send started
+#define SESSION_SEND_CSMA		1												// waiting for the channel to be free
+#define SESSION_SEND_KEY_REQUEST 2												// sending the session key request
+#define SESSION_SEND_KEY_WAIT	3												// waiting for the session key
+#define SESSION_SEND_DATA		4												// sending the data frame
+#define SESSION_SEND_ACK_WAIT	5												// waiting for the ACK
+#define SESSION_SEND_OK			6												// sent, and acknowledged if requested
+#define SESSION_SEND_FAILED		7												// no session key or no ACK after all retries
+
+#if (SESSION_PEER_TABLE_SIZE & (SESSION_PEER_TABLE_SIZE - 1)) != 0
+#error SESSION_PEER_TABLE_SIZE must be a power of 2
+#endif
+#if (SESSION_REPLY_QUEUE_SIZE & (SESSION_REPLY_QUEUE_SIZE - 1)) != 0
+#error SESSION_REPLY_QUEUE_SIZE must be a power of 2
+#endif
+#if SESSION_USE_TX_QUEUE && !SESSION_USE_ASYNC_SEND
+#error SESSION_USE_TX_QUEUE needs SESSION_USE_ASYNC_SEND
+#endif
+#if SESSION_USE_RESUME && !SESSION_USE_MAC
+#error SESSION_USE_RESUME needs SESSION_USE_MAC
+#endif
+#if SESSION_USE_GROUP && !SESSION_USE_MAC
+#error SESSION_USE_GROUP needs SESSION_USE_MAC
+#endif
+#if SESSION_USE_TRACE && ((SESSION_TRACE_SIZE & (SESSION_TRACE_SIZE - 1)) != 0 || SESSION_TRACE_SIZE > 128)
+#error SESSION_TRACE_SIZE must be a power of 2, max 128
+#endif
+#if (SESSION_CTL_MASK & (RFM69_CTL_SENDACK | RFM69_CTL_REQACK | RFM69_CTL_EXT1 | RFM69_CTL_EXT2)) != 0
+#error SESSION_CTL_MASK overlaps the CTL bits of the RFM69 library
+#endif
+
+// !RVDB Session key issued to a remote node, one entry per peer (16 bytes each)
+// Frame n of a session carries key + n; window bit i is set once frame (highest - i) is accepted
+struct SessionPeer {
+  uint8_t nodeID;						// peer node ID (only meaningful when key != 0)
+  unsigned long key;					// session (base) key issued to this peer, 0 when free or fully used
+  unsigned long expires;				// millis() time after which the key is refused
+  uint16_t highest;						// highest frame counter accepted so far
+  uint32_t window;						// replay window of the accepted frame counters, 0 before the first frame
+  uint8_t next;							// 1 for a next key piggy-backed on an ACK (evicted while unused, the only key ever evicted)
+};
+
+// !RVDB Stream being received: session key check of its frames, as for SessionPeer, then reassembly
+// Fragment n holds stream bytes n * SESSION_STREAM_DATA_LEN onwards; sack bit i is set once fragment (base + i) is received
+struct SessionStream {
+  uint8_t state;						// 0 idle, 1 receiving, 2 received and not read yet by streamReceived()
+  uint8_t nodeID;						// node sending the stream
+  unsigned long key;					// session key issued for the stream, 0 when none
+  unsigned long expires;				// millis() time after which the stream is considered dropped
+  uint16_t highest;						// highest frame counter accepted so far
+  uint32_t window;						// replay window of the accepted frame counters
+  uint8_t* buffer;						// reassembly buffer given to receiveStream()
+  uint16_t size;						// size of the reassembly buffer
+  uint16_t length;						// stream length, 0 until the first fragment is received
+  uint16_t base;						// first fragment not received yet
+  uint32_t sack;						// fragments received after base
+};
+
+// !RVDB Called by poll() when a non-blocking send is over (status is SESSION_SEND_OK or SESSION_SEND_FAILED)
+typedef void (*SessionSendCallback)(uint8_t toAddress, uint8_t status);
+
+// !RVDB Called by receiveDone() with a view of the payload received (valid until the next receiveDone())
+typedef void (*SessionReceiveCallback)(uint8_t senderID, const uint8_t* data, uint8_t length);
+
+// !RVDB Round trip time estimate of a remote node (both in us, saturated at 65535)
+struct SessionRtt {
+  uint8_t nodeID;										// remote node, RF69_BROADCAST_ADDR when the entry is free
+  uint16_t srtt;										// smoothed round trip time, 0 until the first sample
+  uint16_t rttvar;										// round trip time variation
+#if SESSION_USE_RESP_DELAY
+  uint16_t respDelay;									// delay before the session key response to this node
+#endif
+  unsigned long ackedKey;								// key of the last frame acknowledged to this node, 0 when none (or acknowledged again)
+  uint32_t ackedTime;									// millis() time of that ACK
+#if SESSION_USE_3ACKS
+  uint8_t ackCopies;									// ACK copies sent to this node on top of the first one, raised by each lost ACK
+  uint8_t ackClean;										// ACKs sent to this node since one was lost
+#endif
+#if SESSION_USE_STATS
+  // !RVDB per peer counters: they share the entry with the RTT estimate, so they only cover the last
+  // SESSION_PEER_TABLE_SIZE nodes heard and start from 0 again when a node gets a new entry (peerEvictions)
+  uint16_t handshakes;									// session keys received from this node
+  uint16_t failures;									// session key requests to this node without answer
+  uint16_t mismatches;									// frames from this node with an unexpected session key
+#endif
+};
+
+// !RVDB Session key response queued by the interrupt handler
+struct SessionReply {
+  uint8_t nodeID;										// requesting node
+  unsigned long key;									// key issued to it
+  uint32_t time;										// micros() time of the request
+  uint8_t type;											// !RVDB SESSION_REPLY_xxx
+};
+
+// !RVDB Resume ticket given to a node (sessionResumeStore), its frames carry the resume key epoch << 24 | counter
+struct SessionResume {
+  uint8_t nodeID;										// node holding the ticket, RF69_BROADCAST_ADDR when the entry is free
+  uint32_t highest;										// highest counter accepted so far
+  uint32_t reserved;									// highest counter saved in the store, the counters above are refused
+};
+
+// !RVDB Called to read or write length bytes of the resume table store at address (EEPROM, flash...)
+typedef void (*SessionStoreRead)(uint16_t address, uint8_t* data, uint8_t length);
+typedef void (*SessionStoreWrite)(uint16_t address, const uint8_t* data, uint8_t length);
+
+// !RVDB Received frame stored in the receive queue (receiveQueue)
+struct SessionFrame {
+  uint8_t senderID;
+  uint8_t targetID;
+  int16_t rssi;
+  uint8_t ctl;											// CTL byte (RFM69_CTL_REQACK set if an ACK is requested)
+  uint8_t length;
+  uint8_t data[RF69_MAX_DATA_LEN];
+  unsigned long key;									// session key of the frame, echoed by sendQueuedACK()
+};
+
+// !RVDB Frame waiting in the send queue (sendQueue) for poll()
+struct SessionTxFrame {
+  uint8_t toAddress;
+  uint8_t priority;										// SESSION_PRIORITY_xxx
+  bool requestACK;
+  uint8_t retries;
+  uint8_t length;
+  uint8_t data[SESSION_MAX_DATA_LEN];
+};
+
+// !RVDB Records waiting to be sent to one node (recordBuffers)
+struct SessionRecordBuffer {
+  uint8_t toAddress;									// destination, RF69_BROADCAST_ADDR when the buffer is free
+  uint8_t length;										// bytes used in data
+  uint32_t firstTime;									// millis() time the oldest record was added
+  uint8_t data[SESSION_MAX_DATA_LEN];					// records: type, length, data
+};
+
+// !RVDB Statistics, monotonic counters (a histogram bucket stops at 65535)
+struct SessionStats {
+  uint32_t handshakesStarted;							// session key requests sent
+  uint32_t handshakesCompleted;							// session keys received in time
+  uint32_t keyTimeouts;									// session key requests without answer
+  uint32_t keysIssued;									// session keys sent to requesting nodes
+  uint32_t keysRefused;									// session key requests left unanswered, the node's table slots held keys in use
+  uint32_t keyMismatches;								// frames received with an unexpected session key
+  uint32_t framesAccepted;								// frames received with the expected session key
+  uint32_t ackTimeouts;									// ACKs not received in time
+  uint32_t ackRepeats;									// ACKs sent again (3 final ACKs)
+  uint32_t csmaWaits;									// sends delayed by a busy channel
+  uint32_t peerEvictions;								// per peer entries (RTT, counters) given to another node
+  uint16_t latency[SESSION_STATS_BUCKETS];				// handshake latency: bucket 0 < 1024us, bucket i < 2^(10+i)us, last one above
+};
+
+// !RVDB Trace ring entry (useSessionTrace)
+struct SessionTraceEntry {
+  uint32_t time;										// micros() time of the event
+  uint8_t event;										// SESSION_TRACE_TX, SESSION_TRACE_RX or SESSION_TRACE_TIMEOUT
+  uint8_t ctl;											// CTL byte of the frame
+  uint8_t peer;											// node the frame is sent to or received from
+  uint8_t status;										// depends on the event
+  unsigned long key;									// session key of the frame (0 if none)
+};
 
 class RFM69_SessionKey: public RFM69 {
   // !RVDB make all these variables private
@@ -71,27 +418,141 @@ static volatile uint8_t SESSION_KEY_INCLUDED; 		// flag in CTL byte indicating t
 static volatile uint8_t SESSION_KEY_REQUESTED; 		// flag in CTL byte indicating this packet is a request for a session key
 static volatile uint8_t SESSION_KEY_RCV_STATUS;		// !RVDB add a variable to indicate the session key status after receive was done 
 private:
-static volatile unsigned long SESSION_KEY; 			// !RVDB set to the session key value for a particular transmission
-static volatile uint8_t SESSION_KEY1; 				// !RVDB set to the session key High value for a particular transmission
-static volatile uint8_t SESSION_KEY2; 				// !RVDB set to the session key Medium value for a particular transmission
-static volatile uint8_t SESSION_KEY3; 				// !RVDB set to the session key Medium value for a particular transmission
-static volatile uint8_t SESSION_KEY4; 				// !RVDB set to the session key Low value for a particular transmission
-static volatile unsigned long INCOMING_SESSION_KEY; // !RVDB set on an incoming packet and used to decide if receiveDone should be true and data should be processed
-static volatile uint8_t INCOMING_SESSION_KEY1; 		// !RVDB set to the session key High value for a particular transmission
-static volatile uint8_t INCOMING_SESSION_KEY2; 		// !RVDB set to the session key Medium value for a particular transmission
-static volatile uint8_t INCOMING_SESSION_KEY3; 		// !RVDB set to the session key Medium value for a particular transmission
-static volatile uint8_t INCOMING_SESSION_KEY4; 		// !RVDB set to the session key Low value for a particular transmission
+static volatile unsigned long SESSION_KEY; 			// !RVDB set to the session key received from SESSION_KEY_PEER, then to the key of the frame sent
+static volatile uint8_t SESSION_KEY_PEER; 			// !RVDB set to the node the session key was requested from
+static volatile unsigned long SESSION_BASE_KEY; 		// !RVDB set to the base key of the burst session with SESSION_KEY_PEER
+static volatile uint8_t SESSION_COUNTER; 			// !RVDB set to the counter of the next frame of the burst session
+static volatile unsigned long SESSION_EXPIRES; 		// !RVDB millis() time at which the burst session ends
+static volatile uint8_t SESSION_ACK_PENDING; 		// !RVDB set while the ACK of the last session frame sent is awaited
+static volatile unsigned long INCOMING_SESSION_KEY; // !RVDB set on an incoming packet, echoed back in the ACK
+static volatile uint8_t SESSION_KEY_ACCEPTED; 		// !RVDB set when the incoming packet carries the expected session key
+static volatile uint8_t SESSION_STREAM_FRAME; 		// !RVDB set when the incoming packet is a stream fragment or its selective ACK
+static volatile unsigned long SESSION_NEXT_KEY; 		// !RVDB key of the next session, piggy-backed on the last ACK of SESSION_NEXT_KEY_PEER
+static volatile uint8_t SESSION_NEXT_KEY_PEER; 		// !RVDB set to the node SESSION_NEXT_KEY was received from
+static volatile unsigned long SESSION_NEXT_KEY_EXPIRES; // !RVDB millis() time after which SESSION_NEXT_KEY is considered stale
+static volatile SessionPeer _peers[SESSION_PEER_TABLE_SIZE]; // !RVDB session keys issued to the remote nodes
+#if SESSION_USE_STREAM
+static volatile SessionStream _stream; 				// !RVDB stream being received
+#endif
+static volatile SessionRtt _rtt[SESSION_PEER_TABLE_SIZE]; // !RVDB round trip time estimates of the remote nodes
+static volatile uint8_t _rttNext; 					// !RVDB next _rtt entry replaced by a new node
+#if SESSION_USE_STATS
+static volatile SessionStats _stats; 				// !RVDB statistics
+#endif
+#if SESSION_USE_TRACE
+static volatile SessionTraceEntry _trace[SESSION_TRACE_SIZE]; // !RVDB trace ring
+static volatile uint16_t _traceCount; 				// !RVDB events recorded, the last SESSION_TRACE_SIZE ones are kept
+static bool _traceEnabled; 							// !RVDB set while the events are recorded
+static volatile uint8_t _traceCTL; 					// !RVDB CTL byte, status and key of the frame being received,
+static volatile uint8_t _traceStatus; 				//       recorded by interruptHandler() (status 0: none)
+static volatile unsigned long _traceKey;
+#endif
+#if SESSION_USE_RX_QUEUE
+static volatile uint8_t _lastCTL; 					// !RVDB CTL byte of the last frame received
+static SessionFrame* _queue; 						// !RVDB receive queue slots (NULL when the queue is not used)
+static uint8_t _queueDepth; 						// !RVDB number of receive queue slots
+static volatile uint8_t _queueHead; 				// !RVDB oldest frame of the receive queue
+static volatile uint8_t _queueCount; 				// !RVDB frames in the receive queue
+static volatile uint32_t _queueDrops; 				// !RVDB frames dropped because the receive queue was full
+#endif
+static volatile SessionReply _replies[SESSION_REPLY_QUEUE_SIZE]; // !RVDB session key responses to send
+static volatile uint8_t _replyHead; 				// !RVDB oldest session key response
+static volatile uint8_t _replyCount; 				// !RVDB session key responses to send
+static volatile bool _replySending; 				// !RVDB set while a queued frame is sent, the interrupt handler ends it
+static bool _replyKeep; 							// !RVDB set when a frame not read yet by receiveDone() is kept meanwhile
+static volatile uint16_t _isrTime; 					// !RVDB longest interrupt handler duration (us) since the last isrTime()
+#if SESSION_USE_MAC
+static SessionMac _mac; 							// !RVDB MAC key schedule, done once by useSessionMac()
+static bool _macEnabled; 							// !RVDB set when the frames with a session key carry a MAC
+static volatile uint8_t _macLength; 				// !RVDB payload bytes already read into DATA by macCheck(), restored by interruptHandler()
+static uint8_t _macFirst; 							// !RVDB DATA[0], overwritten by the base class interrupt handler
+#endif
+#if SESSION_USE_GROUP
+static uint8_t _groupMaster; 						// !RVDB node sending the group broadcasts, RF69_BROADCAST_ADDR when none
+static uint8_t _groupRepeats; 						// !RVDB copies of each group broadcast sent by the master
+static volatile unsigned long _groupCounter; 		// !RVDB epoch (high 16 bits) and counter of the last group broadcast sent or accepted
+#endif
+#if SESSION_USE_RESUME
+static bool _resumeEnabled; 						// !RVDB set when the frames to the node that gave our resume ticket use it
+static volatile uint8_t _resumePeer; 				// !RVDB node that gave our resume ticket, RF69_BROADCAST_ADDR when none
+static volatile unsigned long _resumeKey; 			// !RVDB resume key of the last frame sent with the ticket
+static volatile uint8_t _resumeSent; 				// !RVDB set when the last session frame sent used the resume ticket
+static volatile uint8_t _resumeResync; 				// !RVDB set by the resync answer to that frame
+static volatile uint8_t _resumeLeapt; 				// !RVDB set once the counter leapt after a failed send, until an ACK
+static volatile uint8_t _resumeFailures; 			// !RVDB failed sends since the last acknowledged resume frame
+static SessionResume* _resumes; 					// !RVDB resume tickets given to the remote nodes (NULL when none is given)
+static uint8_t _resumeCount; 						// !RVDB number of resume tickets
+static uint8_t _resumeEpoch; 						// !RVDB epoch of the resume tickets given
+static volatile uint8_t _resumeDirty; 				// !RVDB set when a reservation must be saved by sessionResumeFlush()
+static SessionStoreRead _storeRead; 				// !RVDB resume table store
+static SessionStoreWrite _storeWrite;
+static uint16_t _storeAddress; 						// !RVDB address of the first store slot
+static uint8_t _storeSlots; 						// !RVDB number of store slots, written in turn
+static uint8_t _storeSlot; 							// !RVDB slot of the last resume table saved
+static uint8_t _storeSeq; 							// !RVDB sequence number of the last resume table saved
+#endif
+#if SESSION_USE_RESUME && SESSION_USE_ASYNC_SEND
+static bool _sendResynced; 							// !RVDB set once the non-blocking send got a resync answer
+#endif
 static volatile uint16_t _waitTime; 					// !RVDB used to store the retryWaitTime for multiple ACK Send loop
 static volatile uint16_t _respDelayTime; 		    // !RVDB used to store the Session KEY challenge response for slow remote nodes
+static volatile unsigned long _nextKeyTime; 			// !RVDB used to store the validity time (ms) of a piggy-backed next session key
+static volatile uint8_t _burstFrames; 				// !RVDB used to store the maximum number of frames sent with one session key
+static volatile uint16_t _burstTime; 				// !RVDB used to store the maximum duration (ms) of a burst session
+static uint32_t _txStart; 							// !RVDB millis() time the frame being transmitted was started
+#if SESSION_USE_ASYNC_SEND
+static uint8_t _sendState; 							// !RVDB state of the non-blocking send (SESSION_SEND_xxx)
+static uint8_t _sendTo; 							// !RVDB destination of the non-blocking send
+static uint8_t _sendData[SESSION_MAX_DATA_LEN]; 	// !RVDB payload of the non-blocking send
+static uint8_t _sendSize; 							// !RVDB payload size of the non-blocking send
+static bool _sendRequestACK; 						// !RVDB set if the non-blocking send requests an ACK
+static uint8_t _sendRetries; 						// !RVDB retries left for the non-blocking send
+static uint8_t _sendResend; 						// !RVDB 1: the next attempt sends the frame again with its key, 2: the last attempt did
+static uint32_t _sendTime; 							// !RVDB millis() time the current state of the non-blocking send was entered
+static SessionSendCallback _sendDone; 				// !RVDB called when the non-blocking send is over
+static bool _sendBusy; 								// !RVDB set once the non-blocking send found the channel busy
+static uint32_t _rttStart; 							// !RVDB micros() time the frame waiting for an answer in poll() was sent
+static uint32_t _sendWake; 							// !RVDB millis() time the backoff of the non-blocking send ends
+static uint8_t _sendExponent; 						// !RVDB backoff window of the non-blocking send (2^n slots)
+#endif
+#if SESSION_USE_TX_QUEUE
+static SessionTxFrame* _txQueue; 					// !RVDB send queue slots (NULL when the queue is not used)
+static uint8_t _txDepth; 							// !RVDB number of send queue slots
+static uint8_t _txCount; 							// !RVDB frames in the send queue, oldest first
+#endif
+#if SESSION_USE_ZERO_COPY
+static uint8_t* _rxBuffer; 							// !RVDB payload destination of the interrupt handler (NULL to use DATA)
+static uint8_t _rxSize; 							// !RVDB size of the payload destination
+static volatile uint8_t _rxLength; 					// !RVDB payload bytes stored in the payload destination
+static SessionReceiveCallback _rxCallback; 			// !RVDB called by receiveDone() with the payload received
+#endif
+#if SESSION_USE_RECORDS
+static volatile uint8_t SESSION_RECORDS_FRAME; 		// !RVDB set when the incoming packet is a payload of records
+static uint8_t _recordOffset; 						// !RVDB next record returned by nextRecord()
+static SessionRecordBuffer* _records; 				// !RVDB record buffers (NULL when records are not used)
+static uint8_t _recordCount; 						// !RVDB number of record buffers
+static uint16_t _recordDeadline; 					// !RVDB ms a record waits at most before flushRecords() sends it
+static uint8_t _recordRetries; 						// !RVDB sendWithRetry() retries of a record frame
+#endif
+static uint8_t _backoffSlot; 						// !RVDB backoff slot (ms), 0 without backoff
+static uint8_t _backoffMax; 						// !RVDB largest backoff window (2^n slots)
+static uint32_t _backoffSeed; 						// !RVDB state of the backoff random generator
+static uint32_t _keySeed; 							// !RVDB state of the session key random generator
+static volatile uint16_t _fifoLoadTime; 			// !RVDB us taken by the last startFrame() to load the FIFO
+static volatile uint16_t _keyResponseLoadTime; 		// !RVDB us from the key request in interruptHook() to the key response loaded in the FIFO
+static uint16_t _handshakeTime; 					// !RVDB us from the last key request sent to its session key received
+static uint16_t _ackTime; 							// !RVDB us from the last frame sent to its ACK received
  public:	
     RFM69_SessionKey(uint8_t slaveSelectPin=RF69_SPI_CS, uint8_t interruptPin=RF69_IRQ_PIN, bool isRFM69HW=false, uint8_t interruptNum=RF69_IRQ_NUM) :
       RFM69(slaveSelectPin, interruptPin, isRFM69HW, interruptNum) {
+      SESSION_CONFIG();									// !RVDB link error if the library was built with other options
     }
     
     bool initialize(uint8_t freqBand, uint8_t ID, uint8_t networkID=1); // need to call initialise because _sessionKeyEnabled (new variable) needs to be set as false when first loaded
     void send(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false); // some additions needed
     void sendACK(const void* buffer = "", uint8_t bufferSize=0); // some additions needed
     bool receiveDone(); // some additions needed
+    bool sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries=2, uint8_t retryWaitTime=40); // !RVDB ACK timeout from the RTT estimate
     
     // new public functions for session handling
     void useSessionKey(bool enabled);
@@ -100,16 +561,159 @@ static volatile uint16_t _respDelayTime; 		    // !RVDB used to store the Sessio
     bool session3AcksEnabled ();						// !RVDB new function to check if 3 final ACKs are enabled
     void sessionWaitTime(uint16_t waitTime);  			// !RVDB new function allowing to change of the watchdog time between Session request an Session included
     void sessionRespDelayTime(uint16_t delayTime);  	// !RVDB new function allowing to change the SESSION KEY delay response time for slow nodes
+    void sessionBackoff(uint8_t slotTime, uint8_t maxExponent=SESSION_BACKOFF_MAX); // !RVDB new function setting the random backoff (slot in ms, 0 for none)
+    void useSessionNextKey(bool enabled);				// !RVDB new function to Enable the next session key piggy-backed on the final ACK
+    bool sessionNextKeyEnabled();						// !RVDB new function to check if the next session key is enabled
+    void sessionNextKeyTime(unsigned long lifeTime);	// !RVDB new function allowing to change the validity time of the next session key
+    void sessionBurst(uint8_t frames, uint16_t burstTime); // !RVDB new function allowing several frames to be sent with one session key
+#if SESSION_USE_MAC
+    void useSessionMac(const void* key);				// !RVDB new function setting the 16 byte MAC key, the same on all nodes (NULL for no MAC): it authenticates the fleet, not each node
+    bool sessionMacEnabled();							// !RVDB new function to check if the frames carry a MAC
+#endif
+#if SESSION_USE_GROUP
+    void useSessionGroup(uint8_t masterID, uint16_t epoch=0, uint8_t repeats=1, uint16_t counter=0); // !RVDB new function setting the node whose broadcasts are accepted (RF69_BROADCAST_ADDR for none)
+    uint16_t sessionGroupEpoch();						// !RVDB new function returning the epoch of the last group broadcast sent or accepted
+    unsigned long sessionGroupCounter();				// !RVDB new function returning the epoch (high 16 bits) and counter of the last group broadcast sent or accepted
+#endif
+#if SESSION_USE_RESUME
+    void useSessionResume(bool enabled);				// !RVDB new function to send with the resume ticket of the node it was received from (needs useSessionMac)
+    bool sessionResumeStore(SessionResume* tickets, uint8_t count, SessionStoreRead read, SessionStoreWrite write, uint16_t address, uint16_t size); // !RVDB new function giving resume tickets, saved in a store (true if restored)
+    bool sessionResumeFlush();							// !RVDB new function saving the resume tickets in the store when needed (true if written)
+#endif
+#if SESSION_USE_STREAM
+    bool sendStream(uint8_t toAddress, const void* buffer, uint16_t bufferSize, uint8_t window=8, uint8_t retries=3); // !RVDB new function to send a buffer of any size
+    void receiveStream(void* buffer, uint16_t bufferSize);	// !RVDB new function to set the buffer receiving the next stream (NULL to refuse streams)
+    uint16_t streamReceived();							// !RVDB new function returning the length of the stream received (0 if none)
+    uint8_t streamSender();								// !RVDB new function returning the node the stream was received from
+#endif
+#if SESSION_USE_ASYNC_SEND
+    bool beginSend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false, uint8_t retries=0); // !RVDB new function starting a non-blocking send
+    uint8_t poll();										// !RVDB new function advancing the non-blocking send, returns sendStatus()
+    uint8_t sendStatus();								// !RVDB new function returning the state of the non-blocking send
+    void onSendDone(SessionSendCallback callback);		// !RVDB new function setting the function called when the non-blocking send is over
+#endif
+#if SESSION_USE_TX_QUEUE
+    void sendQueue(SessionTxFrame* slots, uint8_t depth);	// !RVDB new function setting the send queue slots (NULL for none)
+    bool queueSend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false, uint8_t retries=0, uint8_t priority=SESSION_PRIORITY_NORMAL); // !RVDB new function queueing a frame for poll()
+    uint8_t queuedSends();								// !RVDB new function returning the number of frames in the send queue
+#endif
+    uint16_t fifoLoadTime();							// !RVDB new function returning the us the last frame took to be loaded in the FIFO
+    uint16_t keyResponseLoadTime();						// !RVDB new function returning the us from the key request to the key response loaded in the FIFO
+    uint16_t handshakeTime();							// !RVDB new function returning the us from the last key request sent to its session key received
+    uint16_t ackTime();									// !RVDB new function returning the us from the last frame sent to its ACK received
+    uint16_t isrTime();									// !RVDB new function returning the longest interrupt handler duration (us) since the last call
+    void sessionService();								// !RVDB new function sending the queued session key responses
+    uint16_t sessionRtt(uint8_t nodeID);				// !RVDB new function returning the smoothed round trip time (us) to a node (0 if unknown)
+#if SESSION_USE_ZERO_COPY
+    void receiveBuffer(void* buffer, uint8_t bufferSize);	// !RVDB new function setting the buffer the payload is received in (NULL to use DATA)
+    void onReceive(SessionReceiveCallback callback);	// !RVDB new function setting the function called by receiveDone() with the payload
+#endif
+    const uint8_t* receivedData();						// !RVDB new function returning the payload received (receive buffer or DATA)
+    uint8_t receivedLength();							// !RVDB new function returning the length of the payload received
+#if SESSION_USE_RECORDS
+    void recordBuffers(SessionRecordBuffer* buffers, uint8_t count, uint16_t deadline=1000, uint8_t retries=2); // !RVDB new function setting the record buffers (NULL for none)
+    bool sendRecord(uint8_t toAddress, uint8_t type, const void* data, uint8_t length); // !RVDB new function adding a record to the frame to a node
+    bool flushRecords(bool all=false);					// !RVDB new function sending the records waiting since the deadline (or all)
+    bool recordsReceived();								// !RVDB new function checking if the payload received is made of records
+    bool nextRecord(uint8_t* type, const uint8_t** data, uint8_t* length); // !RVDB new function returning the next record of the payload received
+    static bool nextRecord(const uint8_t* payload, uint8_t payloadLength, uint8_t* offset, uint8_t* type, const uint8_t** data, uint8_t* length); // !RVDB same, for any payload (a queued frame)
+#endif
+#if SESSION_USE_STATS
+    void sessionStats(SessionStats* stats);				// !RVDB new function copying the statistics
+    uint8_t sessionStatsDump(uint8_t* buffer, uint8_t size, uint8_t record=SESSION_STATS_GLOBAL); // !RVDB new function writing one statistics record in a compact binary form (per peer: last SESSION_PEER_TABLE_SIZE nodes heard only)
+#endif
+#if SESSION_USE_TRACE
+    void useSessionTrace(bool enabled);					// !RVDB new function starting or stopping the trace recording (started by initialize)
+    uint16_t sessionTraceDump(uint8_t* buffer, uint16_t size, bool clear=false); // !RVDB new function writing the trace ring in a binary blob
+#endif
+#if SESSION_USE_RX_QUEUE
+    void receiveQueue(SessionFrame* slots, uint8_t depth);	// !RVDB new function setting the receive queue slots (NULL to receive with receiveDone() only)
+    bool receiveQueued(SessionFrame* frame);			// !RVDB new function taking the oldest frame of the receive queue
+    uint8_t queuedFrames();								// !RVDB new function returning the number of frames in the receive queue
+    uint32_t queueDrops();								// !RVDB new function returning the number of frames dropped on a full receive queue
+    void sendQueuedACK(const SessionFrame* frame, const void* buffer = "", uint8_t bufferSize=0); // !RVDB new function sending the ACK of a queued frame
+#endif
 
   protected:
    
     void interruptHook(uint8_t CTLbyte);
+    void interruptHandler();							// !RVDB store the received frame in the receive queue, measure the handler duration
     void sendFrame(byte toAddress, const void* buffer, byte size, bool requestACK=false, bool sendACK=false);  // Need this one to match the RFM69 library
-    void sendFrame(uint8_t toAddress, const void* buffer, uint8_t size, bool requestACK, bool sendACK, bool sessionRequested, bool sessionIncluded); // two parameters added for session key support
-    void sendWithSession(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false, uint16_t retryWaitTime=40); // new function to transparently handle session without sketch needing to change
+    void sendFrame(uint8_t toAddress, const void* buffer, uint8_t size, bool requestACK, bool sendACK, bool sessionRequested, bool sessionIncluded, unsigned long sessionKey=0, uint8_t sessionFlags=0); // parameters added for session key support
+    void startFrame(uint8_t toAddress, const void* buffer, uint8_t size, bool requestACK, bool sendACK, bool sessionRequested, bool sessionIncluded, unsigned long sessionKey=0, uint8_t sessionFlags=0); // !RVDB fill the FIFO and start the transmission
+    bool frameSent();									// !RVDB check if the frame started by startFrame() is sent
+    void sendWithSession(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false, uint16_t retryWaitTime=40, uint8_t sessionFlags=0); // new function to transparently handle session without sketch needing to change
+    void sendFlagged(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, uint8_t sessionFlags); // !RVDB body of send(), with session flags in the CTL byte
+    bool retrySend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries, uint8_t retryWaitTime, uint8_t sessionFlags); // !RVDB body of sendWithRetry(), with session flags in the CTL byte
+#if SESSION_USE_RECORDS
+    bool sendRecordBuffer(SessionRecordBuffer* buffer);	// !RVDB send the records of a buffer and free it
+#endif
+    bool cachedSessionKey(uint8_t toAddress);			// !RVDB get the session key without request (burst session or piggy-backed key)
+    void startSession();								// !RVDB start a (burst) session with the key just received
+    void resendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t sessionFlags); // !RVDB send the last session frame again with its key
+    bool repeatAck(uint8_t nodeID, unsigned long key);	// !RVDB queue the ACK of a duplicate of the last frame acknowledged to a node
+    bool queueReply(uint8_t nodeID, unsigned long key, uint32_t time, uint8_t type); // !RVDB queue a frame for sessionService()
+    bool serviceStep();									// !RVDB non-blocking sessionService() step (true while a queued frame is sent)
+    void startReply();									// !RVDB start sending the oldest queued frame
+    void endReply();									// !RVDB a queued frame is sent: the next one, or back to receive mode
+#if SESSION_USE_RESUME
+    bool resumeKey(uint8_t toAddress);					// !RVDB get the key of the next frame to toAddress from the resume ticket
+    void resumeFailed();								// !RVDB count a resume frame without answer: leap the counter, drop the ticket after SESSION_RESUME_FAILURES
+    SessionResume* findResume(uint8_t nodeID);			// !RVDB look up the resume ticket given to a node (NULL if none)
+    bool acceptResume(uint8_t nodeID, unsigned long key); // !RVDB check the resume key of a frame
+    bool resyncResume(uint8_t nodeID);					// !RVDB queue the resync answer to a refused resume frame
+    bool issueTicket(uint8_t nodeID, unsigned long* ticket); // !RVDB give a resume ticket to a node (epoch and last counter)
+    void saveResume(uint32_t reserve);					// !RVDB reserve the next counters of the tickets and save the table in the next store slot
+#endif
+#if SESSION_USE_ASYNC_SEND
+    void endSend(uint8_t status);						// !RVDB end the non-blocking send
+#endif
+    volatile SessionRtt* findRtt(uint8_t nodeID, bool create); // !RVDB get the RTT estimate of a node
+    void rttSample(uint8_t nodeID, uint32_t rtt);		// !RVDB update the RTT estimate of a node with a measured round trip (us)
+    void rttTimeout(uint8_t nodeID);					// !RVDB back off the RTT estimate of a node after a timeout
+    uint16_t sessionTimeout(uint8_t nodeID, uint16_t maxTime); // !RVDB timeout (ms) of an answer from a node
+#if SESSION_USE_RESP_DELAY
+    uint16_t respDelay(uint8_t nodeID);					// !RVDB delay (us) before a session frame to a node
+    void adaptRespDelay(uint8_t nodeID, bool lost);		// !RVDB adapt the key response delay of a node
+#endif
+    void waitCanSend(bool backoff=true);				// !RVDB wait for the channel to be free (CSMA), counted in the statistics
+    uint16_t backoffTime(uint8_t exponent);				// !RVDB random backoff (ms) within a window of 2^exponent slots
+    unsigned long newKey();								// !RVDB random session key, from 1 to 2^31
+    void backoffWait(uint8_t exponent);					// !RVDB wait a random backoff, the key responses are sent meanwhile
+    void countHandshake(uint8_t nodeID, uint32_t latency); // !RVDB count a session key received after latency us
+    void countAck(uint8_t nodeID, uint32_t latency);	// !RVDB an ACK received latency us after the frame was sent
+    void countKeyTimeout(uint8_t nodeID);				// !RVDB count a session key request without answer
+#if SESSION_USE_TRACE
+    void trace(uint8_t event, uint8_t ctl, uint8_t peer, unsigned long key, uint8_t status, uint32_t time); // !RVDB record an event in the trace ring
+    void traceEntry(uint8_t event, uint8_t ctl, uint8_t peer, unsigned long key, uint8_t status, uint32_t time); // !RVDB same, interrupts already off
+#endif
+    void sendACKTo(uint8_t sender, uint8_t receiver, unsigned long key, const void* buffer, uint8_t bufferSize); // !RVDB send the ACK of a frame
+    bool requestSessionKey(uint8_t toAddress, uint16_t retryWaitTime, uint8_t sessionFlags=0); // !RVDB request a session key and wait for it
     void receiveBegin(); // some additions needed
+    unsigned long readSessionKey();						// !RVDB read the session key bytes following the CTL byte
+#if SESSION_USE_ZERO_COPY
+    void readPayload();									// !RVDB read the payload from the FIFO into the receive buffer
+#endif
+#if SESSION_USE_MAC
+    bool macCheck(uint8_t CTLbyte, unsigned long key, unsigned long nextKey, uint8_t keyLength); // !RVDB read the payload into DATA and check its MAC
+#endif
+    volatile SessionPeer* findPeer(uint8_t nodeID);	// !RVDB look up the session table entry of a peer (NULL if none)
+    volatile SessionPeer* allocPeer(uint8_t nodeID);	// !RVDB get a session table entry for a peer, evicting an unused next key if needed
+    unsigned long issueKey(uint8_t nodeID, unsigned long lifeTime, bool next = false); // !RVDB generate a new session key for a peer
+    bool acceptCounter(volatile SessionPeer* peer, unsigned long counter); // !RVDB check a frame counter against the peer replay window
+    bool acceptWindow(volatile uint16_t& highest, volatile uint32_t& window, uint16_t counter); // !RVDB sliding replay window check
+#if SESSION_USE_GROUP
+    void sendGroup(const void* buffer, uint8_t bufferSize);	// !RVDB send a group broadcast with the next epoch/counter
+    bool acceptGroup(unsigned long counter);			// !RVDB check the epoch/counter of a group broadcast
+#endif
+#if SESSION_USE_STREAM
+    unsigned long issueStreamKey(uint8_t nodeID);		// !RVDB generate the session key of a stream (0 if a stream is already in progress)
+    bool acceptStreamKey(unsigned long key);			// !RVDB check the session key of a stream fragment
+    void streamFragment();								// !RVDB reassemble a received stream fragment and send the selective ACK
+#endif
     bool _sessionKeyEnabled; // protected variable to indicate if session key support is enabled
     bool _session3AcksEnabled; // !RVDB protected variable to indicate if 3 final Acks support is enabled
+    bool _sessionNextKeyEnabled; // !RVDB protected variable to indicate if the next session key is piggy-backed on the final ACK
 };
 
 #endif
\ No newline at end of file
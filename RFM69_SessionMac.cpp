@@ -0,0 +1,131 @@
+// **********************************************************************************
+// Message authentication code of the RFM69_SessionKey frames (Chaskey), see RFM69_SessionMac.h
+// **********************************************************************************
+#include "RFM69_SessionMac.h"
+#include <string.h>
+
+#define ROTL(x, b) (uint32_t)(((x) << (b)) | ((x) >> (32 - (b))))
+
+//=============================================================================
+// load() - 4 bytes little endian
+//=============================================================================
+static inline uint32_t load(const uint8_t* p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint32_t x;
+  memcpy(&x, p, 4);										// one load on ESP8266 and the host, 4 on AVR
+  return x;
+#else
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+#endif
+}
+
+//=============================================================================
+// timesTwo() - Multiplication by x in GF(2^128), gives the subkeys
+//=============================================================================
+static void timesTwo(uint32_t* out, const uint32_t* in)
+{
+  uint32_t carry = (in[3] >> 31) ? 0x87 : 0;
+  out[3] = (in[3] << 1) | (in[2] >> 31);
+  out[2] = (in[2] << 1) | (in[1] >> 31);
+  out[1] = (in[1] << 1) | (in[0] >> 31);
+  out[0] = (in[0] << 1) ^ carry;
+}
+
+//=============================================================================
+// setKey() - Key schedule, done once: the message functions only use the result
+//=============================================================================
+void SessionMac::setKey(const void* key)
+{
+  const uint8_t* k = (const uint8_t*)key;
+  for (uint8_t i = 0; i < 4; i++)
+    _key[i] = load(k + 4 * i);
+  timesTwo(_key1, _key);
+  timesTwo(_key2, _key1);
+  begin();
+}
+
+//=============================================================================
+// begin() - Start a new message
+//=============================================================================
+void SessionMac::begin()
+{
+  memcpy(_state, _key, sizeof(_state));
+  _count = 0;
+}
+
+//=============================================================================
+// update() - Add bytes to the message. A full block is only absorbed when more bytes
+//            follow, as the last block gets K1 or K2
+//=============================================================================
+void SessionMac::update(const void* data, uint8_t length)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  while (length > 0)
+  {
+    if (_count == SESSION_MAC_BLOCK) absorb();
+    uint8_t n = SESSION_MAC_BLOCK - _count;
+    if (n > length) n = length;
+    memcpy(_block + _count, p, n);
+    _count += n;
+    p += n;
+    length -= n;
+  }
+}
+
+//=============================================================================
+// finish() - Last block: a full one is xored with K1, a partial one is padded
+//            (0x01 then zeros) and xored with K2. Returns the truncated tag
+//=============================================================================
+uint32_t SessionMac::finish()
+{
+  const uint32_t* last = _key1;
+  if (_count < SESSION_MAC_BLOCK)
+  {
+    _block[_count] = 0x01;
+    memset(_block + _count + 1, 0, SESSION_MAC_BLOCK - 1 - _count);
+    last = _key2;
+  }
+  for (uint8_t i = 0; i < 4; i++)
+    _state[i] ^= load(_block + 4 * i) ^ last[i];
+  permute();
+  _count = 0;
+  return _state[0] ^ last[0];
+}
+
+//=============================================================================
+// tag() - Tag of one contiguous message
+//=============================================================================
+uint32_t SessionMac::tag(const void* data, uint8_t length)
+{
+  begin();
+  update(data, length);
+  return finish();
+}
+
+//=============================================================================
+// absorb() - Xor the full block in the state and permute
+//=============================================================================
+void SessionMac::absorb()
+{
+  for (uint8_t i = 0; i < 4; i++)
+    _state[i] ^= load(_block + 4 * i);
+  permute();
+  _count = 0;
+}
+
+//=============================================================================
+// permute() - Chaskey permutation: additions, rotations and xors on 4 words
+//=============================================================================
+void SessionMac::permute()
+{
+  uint32_t v0 = _state[0], v1 = _state[1], v2 = _state[2], v3 = _state[3];
+  for (uint8_t r = 0; r < SESSION_MAC_ROUNDS; r++)
+  {
+    v0 += v1; v1 = ROTL(v1, 5); v1 ^= v0; v0 = ROTL(v0, 16);
+    v2 += v3; v3 = ROTL(v3, 8); v3 ^= v2;
+    v0 += v3; v3 = ROTL(v3, 13); v3 ^= v0;
+    v2 += v1; v1 = ROTL(v1, 7); v1 ^= v2; v2 = ROTL(v2, 16);
+  }
+  _state[0] = v0; _state[1] = v1; _state[2] = v2; _state[3] = v3;
+}
@@ -0,0 +1,40 @@
+// **********************************************************************************
+// Message authentication code of the RFM69_SessionKey frames
+// **********************************************************************************
+// Chaskey (Mouha et al., SAC 2014): a MAC built on a 32-bit add-rotate-xor permutation,
+// designed for 8/16/32-bit microcontrollers. No table, no multiplication, 16 bytes of key
+// plus the two subkeys derived from it once by setKey(). The tag is truncated to 32 bits.
+// SESSION_MAC_ROUNDS selects Chaskey (8 rounds, the original) or Chaskey-12 (12 rounds, the
+// default, recommended by the authors since 2015). Plain C++, also built on the host by
+// extras/SessionMacBench
+// **********************************************************************************
+#ifndef RFM69_SessionMac_h
+#define RFM69_SessionMac_h
+#include <stdint.h>
+
+#ifndef SESSION_MAC_ROUNDS
+#define SESSION_MAC_ROUNDS		12												// permutation rounds per 16 byte block (8 or 12)
+#endif
+#define SESSION_MAC_KEY_LENGTH	16												// key bytes of setKey()
+#define SESSION_MAC_BLOCK		16												// bytes absorbed per permutation
+
+class SessionMac {
+ public:
+    void setKey(const void* key);						// key schedule: SESSION_MAC_KEY_LENGTH bytes, subkeys K1 and K2
+    void begin();										// start a new message
+    void update(const void* data, uint8_t length);		// add bytes to the message
+    uint32_t finish();									// tag of the message (its first 4 bytes, little endian)
+    uint32_t tag(const void* data, uint8_t length);		// begin(), update() and finish() in one call
+
+ private:
+    void absorb();										// xor the full block in the state and permute
+    void permute();
+    uint32_t _key[4];									// K
+    uint32_t _key1[4];									// K1 = 2.K, xored in a full last block
+    uint32_t _key2[4];									// K2 = 4.K, xored in a padded last block
+    uint32_t _state[4];
+    uint8_t _block[SESSION_MAC_BLOCK];					// bytes not absorbed yet, the last block is kept until finish()
+    uint8_t _count;										// bytes in _block
+};
+
+#endif
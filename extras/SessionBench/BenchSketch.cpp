@@ -0,0 +1,15 @@
+// **********************************************************************************
+// Examples/RFM69-bench-session for the host backend
+// **********************************************************************************
+// The sketch as it is flashed on the nodes, built into a sketch library of SessionHost
+// (see SessionBench.cpp): the initiator by default, the responder with -DBENCH_RESPONDER.
+// The Arduino IDE declares the functions of a sketch before it, so does this file.
+// **********************************************************************************
+#include <Arduino.h>
+
+void runBenchmark();
+void benchSize(uint8_t size);
+void sortSamples(uint16_t* samples, uint8_t count);
+uint8_t percentile(uint8_t count, uint8_t pct);
+
+#include "../../Examples/RFM69-bench-session/RFM69-bench-session.ino"
@@ -0,0 +1,145 @@
+// **********************************************************************************
+// RFM69_SessionKey session benchmark on the host
+// **********************************************************************************
+// Runs Examples/RFM69-bench-session on two nodes of the host backend (extras/SessionHost):
+// the real RFM69_SessionKey.cpp over the simulated RFM69 (FIFO, DIO0 interrupt, air time at
+// the bitrate set by the library), so a change of the library shows in the p50/p99 round
+// trip and the goodput of each payload size up to SESSION_MAX_DATA_LEN without a Moteino.
+//
+// Build and run on the host (Linux), from this directory:
+//   S="BenchSketch.cpp ../../RFM69_SessionKey.cpp ../../RFM69_SessionMac.cpp ../SessionHost/RFM69.cpp"
+//   g++ -O2 -std=gnu++11 -shared -fPIC -Wl,-Bsymbolic -I../SessionHost -I../.. -o bench-initiator.so $S
+//   g++ -O2 -std=gnu++11 -shared -fPIC -Wl,-Bsymbolic -I../SessionHost -I../.. -DBENCH_RESPONDER -o bench-responder.so $S
+//   g++ -O2 -std=gnu++11 -rdynamic -I../SessionHost -o session-bench SessionBench.cpp ../SessionHost/SessionHost.cpp -ldl
+//   ./session-bench
+// Add the same -D options to both libraries to measure another configuration of the library
+// (e.g. -DSESSION_USE_MAC=0) or of the sketch (-DBENCH_SAMPLES=200 -DBENCH_STEP=1, or
+// -DBENCH_LOOP_MS=20 for a responder busy 20 ms between two receiveDone() calls). The
+// columns are those of the sketch (size, ok, p50(us), p99(us), goodput(B/s), fifo(us),
+// srtt(us), hs(us), ack(us)), then the 's' line of the responder (its last key response time, from the
+// key request to the response loaded in the FIFO, and its longest interrupt handler) and
+// the longest interrupt handler of the responder measured by the host; the exit code is 1 if the run does not end within --timeout.
+// The host backend counts the time of the Arduino, SPI and EEPROM calls and of the radio,
+// not the computation of the library between them (e.g. the MAC tags, see SessionMacBench):
+// the numbers are the protocol and air time part of the round trip, for comparisons.
+// **********************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "SessionHost.h"
+
+static const char* initiatorPath = "./bench-initiator.so";
+static const char* responderPath = "./bench-responder.so";
+static double pathLoss = 60;					// dB between the two nodes
+static double linkLoss = 0;						// frame loss probability of each way
+static long seed = 1;
+static long timeout = 3600;					// s of simulated time
+
+static void usage()
+{
+  printf("usage: session-bench [options]\n"
+    "  --initiator ./bench-initiator.so  sketch library of the initiator\n"
+    "  --responder ./bench-responder.so  sketch library of the responder\n"
+    "  --path-loss 60            dB between the nodes (13 dBm sent, -95 dBm sensitivity)\n"
+    "  --loss 0                  frame loss probability of each way (0 to 1)\n"
+    "  --seed 1                  losses and random() of the nodes\n"
+    "  --timeout 3600            s of simulated time\n");
+}
+
+static bool parseLong(const char* name, const char* v, long low, long high, long* value)
+{
+  char* end;
+  errno = 0;
+  long x = strtol(v, &end, 10);
+  if (*v == 0 || *end != 0 || errno != 0 || x < low || x > high)
+  {
+    fprintf(stderr, "session-bench: %s must be an integer from %ld to %ld, not '%s'\n", name, low, high, v);
+    return false;
+  }
+  *value = x;
+  return true;
+}
+
+static bool parseDouble(const char* name, const char* v, double low, double high, double* value)
+{
+  char* end;
+  errno = 0;
+  double x = strtod(v, &end);
+  if (*v == 0 || *end != 0 || errno != 0 || !(x >= low && x <= high))
+  {
+    fprintf(stderr, "session-bench: %s must be a number from %g to %g, not '%s'\n", name, low, high, v);
+    return false;
+  }
+  *value = x;
+  return true;
+}
+
+static bool parse(int argc, char** argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const char* o = argv[i];
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "session-bench: %s needs a value\n", o);
+      return false;
+    }
+    const char* v = argv[++i];
+    bool ok;
+    if (!strcmp(o, "--initiator")) { initiatorPath = v; ok = true; }
+    else if (!strcmp(o, "--responder")) { responderPath = v; ok = true; }
+    else if (!strcmp(o, "--path-loss")) ok = parseDouble(o, v, 0, 200, &pathLoss);
+    else if (!strcmp(o, "--loss")) ok = parseDouble(o, v, 0, 1, &linkLoss);
+    else if (!strcmp(o, "--seed")) ok = parseLong(o, v, 0, 0x7FFFFFFF, &seed);
+    else if (!strcmp(o, "--timeout")) ok = parseLong(o, v, 1, 1000000, &timeout);
+    else
+    {
+      fprintf(stderr, "session-bench: unknown option %s\n", o);
+      ok = false;
+    }
+    if (!ok) return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  if (!parse(argc, argv))
+  {
+    usage();
+    return 2;
+  }
+  HostChannel channel = { -110, -95, 10, pathLoss, (uint32_t)seed };
+  hostBegin(channel);
+  int initiator = hostNode(initiatorPath);
+  int responder = hostNode(responderPath);
+  if (initiator < 0 || responder < 0) return 2;
+  hostLinkLoss(initiator, responder, linkLoss);
+  hostLinkLoss(responder, initiator, linkLoss);
+  hostEcho(initiator, true);
+  hostInput(initiator, "b");
+  while (!hostIdle(initiator) && hostTime() < (uint64_t)timeout * 1000000)
+    hostRun(hostTime() + 100000);
+  fflush(stdout);
+  bool done = hostIdle(initiator);
+  if (done)
+  {
+    hostEcho(responder, true);							// its last key response time and longest ISR, as the sketch measures them
+    hostInput(responder, "s");
+    hostRun(hostTime() + 100000);
+    fflush(stdout);
+  }
+  HostChannelStats stats = hostChannelStats();
+  printf("\n%.1f s simulated, frames sent %u, received %u, collisions %u, losses %u, responder ISR max %u us\n",
+    hostTime() / 1e6, stats.frames, stats.received, stats.collisions, stats.losses, hostIsrTime(responder));
+  fflush(stdout);
+  hostEnd();
+  if (!done)
+  {
+    fprintf(stderr, "session-bench: not finished after %ld s\n", timeout);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,97 @@
+// **********************************************************************************
+// Arduino core stand-in of the host backend
+// **********************************************************************************
+// The part of the Arduino core used by RFM69_SessionKey, the RFM69 base class and the
+// example sketches, for a sketch running on a node simulated by SessionHost.cpp.
+// Each call costs the time it takes on a 16 MHz ATmega328 (see SessionHost.h): the
+// simulated clock of a node only advances in these calls, in the SPI transfers and
+// while waiting in delay(). The computations in between take no time.
+//
+// Wiring of every node: radio NSS on pin SS, DIO0 on pin 2 (interrupt 0), as a Moteino.
+// **********************************************************************************
+#ifndef Arduino_h
+#define Arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH			1
+#define LOW				0
+#define INPUT			0
+#define OUTPUT			1
+#define INPUT_PULLUP	2
+#define CHANGE			1
+#define FALLING			2
+#define RISING			3
+#define SS				10
+#define MOSI			11
+#define MISO			12
+#define SCK				13
+#define DEC				10
+#define HEX				16
+#define OCT				8
+#define BIN				2
+#define PROGMEM
+#define F(string)		(string)
+#define digitalPinToInterrupt(pin) ((pin) == 2 ? 0 : ((pin) == 3 ? 1 : -1))
+
+// The sketch entry points, looked up by name in the sketch library of each node
+extern "C" void setup(void);
+extern "C" void loop(void);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+void noInterrupts(void);
+void interrupts(void);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interruptNum, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+// Host only: the CPU idles until the next interrupt or Serial input (sleep_mode() in
+// SLEEP_MODE_IDLE) or for at most ms, so a gateway loop does not spin on receiveDone()
+// between the frames
+void hostSleep(unsigned long ms);
+
+// Serial of the node: the input is given by the host program, the output is printed on stdout
+// when the host program echoes the node
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int peek();
+    int read();
+    void flush();
+    size_t write(uint8_t value);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* string);
+    size_t print(const char* string);
+    size_t print(char value);
+    size_t print(unsigned char value, int base=DEC);
+    size_t print(int value, int base=DEC);
+    size_t print(unsigned int value, int base=DEC);
+    size_t print(long value, int base=DEC);
+    size_t print(unsigned long value, int base=DEC);
+    size_t print(double value, int digits=2);
+    size_t println();
+    template<class T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template<class T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+    operator bool() { return true; }
+};
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,32 @@
+// **********************************************************************************
+// EEPROM library stand-in of the host backend
+// **********************************************************************************
+// 1 KB per node (ATmega328), kept by the host when the node restarts. Each byte written
+// costs 3.3 ms as on the AVR, update() only writes the bytes that differ.
+// **********************************************************************************
+#ifndef EEPROM_h
+#define EEPROM_h
+#include <Arduino.h>
+
+class EEPROMClass {
+  public:
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value);
+    uint16_t length();
+    template<class T> T& get(int address, T& value)
+    {
+      uint8_t* p = (uint8_t*)&value;
+      for (size_t i = 0; i < sizeof(T); i++) p[i] = read(address + i);
+      return value;
+    }
+    template<class T> const T& put(int address, const T& value)
+    {
+      const uint8_t* p = (const uint8_t*)&value;
+      for (size_t i = 0; i < sizeof(T); i++) update(address + i, p[i]);
+      return value;
+    }
+};
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,447 @@
+// **********************************************************************************
+// RFM69 base class of the host backend
+// **********************************************************************************
+// The RFM69 library 1.0 (LowPowerLab) driver logic, register for register: what the
+// session layer sees of its base class (mode changes, CSMA, FIFO reads in the interrupt
+// handler, interrupts masked while the NSS pin is low) is what runs on the nodes.
+// **********************************************************************************
+#include <RFM69.h>
+#include <RFM69registers.h>
+#include <SPI.h>
+
+volatile uint8_t RFM69::DATA[RF69_MAX_DATA_LEN];
+volatile uint8_t RFM69::_mode;        // current transceiver state
+volatile uint8_t RFM69::DATALEN;
+volatile uint8_t RFM69::SENDERID;
+volatile uint8_t RFM69::TARGETID;     // should match _address
+volatile uint8_t RFM69::PAYLOADLEN;
+volatile uint8_t RFM69::ACK_REQUESTED;
+volatile uint8_t RFM69::ACK_RECEIVED; // should be polled immediately after sending a packet with ACK request
+volatile int16_t RFM69::RSSI;         // most accurate RSSI during reception (closest to the reception)
+volatile bool RFM69::_inISR;
+RFM69* RFM69::selfPointer;
+
+bool RFM69::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t networkID)
+{
+  const uint8_t CONFIG[][2] =
+  {
+    /* 0x01 */ { REG_OPMODE, RF_OPMODE_SEQUENCER_ON | RF_OPMODE_LISTEN_OFF | RF_OPMODE_STANDBY },
+    /* 0x02 */ { REG_DATAMODUL, RF_DATAMODUL_DATAMODE_PACKET | RF_DATAMODUL_MODULATIONTYPE_FSK | RF_DATAMODUL_MODULATIONSHAPING_00 }, // no shaping
+    /* 0x03 */ { REG_BITRATEMSB, RF_BITRATEMSB_55555}, // 55.5 kbps
+    /* 0x04 */ { REG_BITRATELSB, RF_BITRATELSB_55555},
+    /* 0x05 */ { REG_FDEVMSB, RF_FDEVMSB_50000}, // 50 kHz, (FDEV + BitRate / 2 <= 500KHz)
+    /* 0x06 */ { REG_FDEVLSB, RF_FDEVLSB_50000},
+
+    /* 0x07 */ { REG_FRFMSB, (uint8_t) (freqBand==RF69_315MHZ ? RF_FRFMSB_315 : (freqBand==RF69_433MHZ ? RF_FRFMSB_433 : (freqBand==RF69_868MHZ ? RF_FRFMSB_868 : RF_FRFMSB_915))) },
+    /* 0x08 */ { REG_FRFMID, (uint8_t) (freqBand==RF69_315MHZ ? RF_FRFMID_315 : (freqBand==RF69_433MHZ ? RF_FRFMID_433 : (freqBand==RF69_868MHZ ? RF_FRFMID_868 : RF_FRFMID_915))) },
+    /* 0x09 */ { REG_FRFLSB, (uint8_t) (freqBand==RF69_315MHZ ? RF_FRFLSB_315 : (freqBand==RF69_433MHZ ? RF_FRFLSB_433 : (freqBand==RF69_868MHZ ? RF_FRFLSB_868 : RF_FRFLSB_915))) },
+
+    /* 0x19 */ { REG_RXBW, RF_RXBW_DCCFREQ_010 | RF_RXBW_MANT_16 | RF_RXBW_EXP_2 }, // (BitRate < 2 * RxBw)
+    /* 0x25 */ { REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_01 }, // DIO0 is the only IRQ we're using
+    /* 0x26 */ { REG_DIOMAPPING2, RF_DIOMAPPING2_CLKOUT_OFF }, // DIO5 ClkOut disable for power saving
+    /* 0x28 */ { REG_IRQFLAGS2, RF_IRQFLAGS2_FIFOOVERRUN }, // writing to this bit ensures that the FIFO & status flags are reset
+    /* 0x29 */ { REG_RSSITHRESH, 220 }, // must be set to dBm = (-Sensitivity / 2), default is 0xE4 = 228 so -114dBm
+    /* 0x2E */ { REG_SYNCCONFIG, RF_SYNC_ON | RF_SYNC_FIFOFILL_AUTO | RF_SYNC_SIZE_2 | RF_SYNC_TOL_0 },
+    /* 0x2F */ { REG_SYNCVALUE1, 0x2D },      // attempt to make this compatible with sync1 byte of RFM12B lib
+    /* 0x30 */ { REG_SYNCVALUE2, networkID }, // NETWORK ID
+    /* 0x37 */ { REG_PACKETCONFIG1, RF_PACKET1_FORMAT_VARIABLE | RF_PACKET1_DCFREE_OFF | RF_PACKET1_CRC_ON | RF_PACKET1_CRCAUTOCLEAR_ON | RF_PACKET1_ADRSFILTERING_OFF },
+    /* 0x38 */ { REG_PAYLOADLENGTH, 66 }, // in variable length mode: the max frame size, not used in TX
+    /* 0x3C */ { REG_FIFOTHRESH, RF_FIFOTHRESH_TXSTART_FIFONOTEMPTY | RF_FIFOTHRESH_VALUE }, // TX on FIFO not empty
+    /* 0x3D */ { REG_PACKETCONFIG2, RF_PACKET2_RXRESTARTDELAY_2BITS | RF_PACKET2_AUTORXRESTART_ON | RF_PACKET2_AES_OFF }, // RXRESTARTDELAY must match transmitter PA ramp-down time (bitrate dependent)
+    /* 0x6F */ { REG_TESTDAGC, RF_DAGC_IMPROVED_LOWBETA0 }, // run DAGC continuously in RX mode for Fading Margin Improvement, recommended default for AfcLowBetaOn=0
+    {255, 0}
+  };
+
+  digitalWrite(_slaveSelectPin, HIGH);
+  pinMode(_slaveSelectPin, OUTPUT);
+  SPI.begin();
+  unsigned long start = millis();
+  uint8_t timeout = 50;
+  do writeReg(REG_SYNCVALUE1, 0xAA); while (readReg(REG_SYNCVALUE1) != 0xaa && millis()-start < timeout);
+  start = millis();
+  do writeReg(REG_SYNCVALUE1, 0x55); while (readReg(REG_SYNCVALUE1) != 0x55 && millis()-start < timeout);
+
+  for (uint8_t i = 0; CONFIG[i][0] != 255; i++)
+    writeReg(CONFIG[i][0], CONFIG[i][1]);
+
+  // Encryption is persistent between resets and can trip you up during debugging.
+  // Disable it during initialization so we always start from a known state.
+  encrypt(0);
+
+  setHighPower(_isRFM69HW); // called regardless if it's a RFM69W or RFM69HW
+  setMode(RF69_MODE_STANDBY);
+  start = millis();
+  while (((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00) && millis()-start < timeout); // wait for ModeReady
+  if (millis()-start >= timeout)
+    return false;
+  _inISR = false;
+  attachInterrupt(_interruptNum, RFM69::isr0, RISING);
+
+  selfPointer = this;
+  _address = nodeID;
+  return true;
+}
+
+// return the frequency (in Hz)
+uint32_t RFM69::getFrequency()
+{
+  return RF69_FSTEP * (((uint32_t) readReg(REG_FRFMSB) << 16) + ((uint16_t) readReg(REG_FRFMID) << 8) + readReg(REG_FRFLSB));
+}
+
+// set the frequency (in Hz)
+void RFM69::setFrequency(uint32_t freqHz)
+{
+  uint8_t oldMode = _mode;
+  if (oldMode == RF69_MODE_TX) {
+    setMode(RF69_MODE_RX);
+  }
+  freqHz /= RF69_FSTEP; // divide down by FSTEP to get FRF
+  writeReg(REG_FRFMSB, freqHz >> 16);
+  writeReg(REG_FRFMID, freqHz >> 8);
+  writeReg(REG_FRFLSB, freqHz);
+  if (oldMode == RF69_MODE_RX) {
+    setMode(RF69_MODE_SYNTH);
+  }
+  setMode(oldMode);
+}
+
+void RFM69::setMode(uint8_t newMode)
+{
+  if (newMode == _mode)
+    return;
+
+  switch (newMode) {
+    case RF69_MODE_TX:
+      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_TRANSMITTER);
+      if (_isRFM69HW) setHighPowerRegs(true);
+      break;
+    case RF69_MODE_RX:
+      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_RECEIVER);
+      if (_isRFM69HW) setHighPowerRegs(false);
+      break;
+    case RF69_MODE_SYNTH:
+      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SYNTHESIZER);
+      break;
+    case RF69_MODE_STANDBY:
+      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_STANDBY);
+      break;
+    case RF69_MODE_SLEEP:
+      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SLEEP);
+      break;
+    default:
+      return;
+  }
+
+  // we are using packet mode, so this check is not really needed
+  // but waiting for mode ready is necessary when going from sleep because the FIFO may not be immediately available from previous mode
+  while (_mode == RF69_MODE_SLEEP && (readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
+
+  _mode = newMode;
+}
+
+//put transceiver in sleep mode to save battery - to wake or resume receiving just call receiveDone()
+void RFM69::sleep() {
+  setMode(RF69_MODE_SLEEP);
+}
+
+//set this node's address
+void RFM69::setAddress(uint8_t addr)
+{
+  _address = addr;
+  writeReg(REG_NODEADRS, _address);
+}
+
+//set this node's network id
+void RFM69::setNetwork(uint8_t networkID)
+{
+  writeReg(REG_SYNCVALUE2, networkID);
+}
+
+// set *transmit/TX* output power: 0=min, 31=max
+// this results in a "weaker" transmitted signal, and directly results in a lower RSSI at the receiver
+// the power configurations are explained in the SX1231H datasheet (Table 10 on p21; RegPaLevel p66): http://www.semtech.com/images/datasheet/sx1231h.pdf
+// valid powerLevel parameter values are 0-31 and result in a directly proportional effect on the output/transmission power
+// this function implements 2 modes as follows:
+//       - for RFM69W the range is from 0-31 [-18dBm to 13dBm] (PA0 only on RFIO pin)
+//       - for RFM69HW the range is from 0-31 [5dBm to 20dBm]  (PA1 & PA2 on PA_BOOST pin & high Power PA settings - see section 3.3.7 in datasheet, p22)
+void RFM69::setPowerLevel(uint8_t powerLevel)
+{
+  _powerLevel = (powerLevel > 31 ? 31 : powerLevel);
+  if (_isRFM69HW) _powerLevel /= 2;
+  writeReg(REG_PALEVEL, (readReg(REG_PALEVEL) & 0xE0) | _powerLevel);
+}
+
+bool RFM69::canSend()
+{
+  if (_mode == RF69_MODE_RX && PAYLOADLEN == 0 && readRSSI() < CSMA_LIMIT) // if signal stronger than -100dBm is detected assume channel activity
+  {
+    setMode(RF69_MODE_STANDBY);
+    return true;
+  }
+  return false;
+}
+
+void RFM69::send(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK)
+{
+  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+  uint32_t now = millis();
+  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
+  sendFrame(toAddress, buffer, bufferSize, requestACK, false);
+}
+
+// to increase the chance of getting a packet across, call this function instead of send
+// and it handles all the ACK requesting/retrying for you :)
+// The only twist is that you have to manually listen to ACK requests on the other side and send back the ACKs
+// The reason for the semi-automaton is that the lib is interrupt driven and
+// requires user action to read the received data and decide what to do with it
+// replies usually take only 5..8ms at 50kbps@915MHz
+bool RFM69::sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries, uint8_t retryWaitTime) {
+  uint32_t sentTime;
+  for (uint8_t i = 0; i <= retries; i++)
+  {
+    send(toAddress, buffer, bufferSize, true);
+    sentTime = millis();
+    while (millis() - sentTime < retryWaitTime)
+    {
+      if (ACKReceived(toAddress))
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// should be polled immediately after sending a packet with ACK request
+bool RFM69::ACKReceived(uint8_t fromNodeID) {
+  if (receiveDone())
+    return (SENDERID == fromNodeID || fromNodeID == RF69_BROADCAST_ADDR) && ACK_RECEIVED;
+  return false;
+}
+
+// check whether an ACK was requested in the last received packet (non-broadcasted packet)
+bool RFM69::ACKRequested() {
+  return ACK_REQUESTED && (TARGETID != RF69_BROADCAST_ADDR);
+}
+
+// should be called immediately after reception in case sender wants ACK
+void RFM69::sendACK(const void* buffer, uint8_t bufferSize) {
+  ACK_REQUESTED = 0;   // TWS added to make sure we don't end up in a timing race and infinite loop sending Acks
+  uint8_t sender = SENDERID;
+  int16_t _RSSI = RSSI; // save payload received RSSI value
+  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+  uint32_t now = millis();
+  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
+  SENDERID = sender;    // TWS: Restore SenderID after it gets wiped out by receiveDone()
+  sendFrame(sender, buffer, bufferSize, false, true);
+  RSSI = _RSSI; // restore payload RSSI
+}
+
+// internal function
+void RFM69::sendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK)
+{
+  setMode(RF69_MODE_STANDBY); // turn off receiver to prevent reception while filling fifo
+  while ((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
+  writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_00); // DIO0 is "Packet Sent"
+  if (bufferSize > RF69_MAX_DATA_LEN) bufferSize = RF69_MAX_DATA_LEN;
+
+  // control byte
+  uint8_t CTLbyte = 0x00;
+  if (sendACK)
+    CTLbyte = RFM69_CTL_SENDACK;
+  else if (requestACK)
+    CTLbyte = RFM69_CTL_REQACK;
+
+  // write to FIFO
+  select();
+  SPI.transfer(REG_FIFO | 0x80);
+  SPI.transfer(bufferSize + 3);
+  SPI.transfer(toAddress);
+  SPI.transfer(_address);
+  SPI.transfer(CTLbyte);
+
+  for (uint8_t i = 0; i < bufferSize; i++)
+    SPI.transfer(((uint8_t*) buffer)[i]);
+  unselect();
+
+  // no need to wait for transmit mode to be ready since its handled by the radio
+  setMode(RF69_MODE_TX);
+  uint32_t txStart = millis();
+  while (digitalRead(_interruptPin) == 0 && millis() - txStart < RF69_TX_LIMIT_MS); // wait for DIO0 to turn HIGH signalling transmission finish
+  //while (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PACKETSENT == 0x00); // wait for ModeReady
+  setMode(RF69_MODE_STANDBY);
+}
+
+// internal function - interrupt gets called when a packet is received
+void RFM69::interruptHandler() {
+  if (_mode == RF69_MODE_RX && (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY))
+  {
+    //RSSI = readRSSI();
+    setMode(RF69_MODE_STANDBY);
+    select();
+    SPI.transfer(REG_FIFO & 0x7F);
+    PAYLOADLEN = SPI.transfer(0);
+    PAYLOADLEN = PAYLOADLEN > 66 ? 66 : PAYLOADLEN; // precaution
+    TARGETID = SPI.transfer(0);
+    if(!(_promiscuousMode || TARGETID == _address || TARGETID == RF69_BROADCAST_ADDR) // match this node's address, or broadcast address or anything in promiscuous mode
+       || PAYLOADLEN < 3) // address situation could receive packets that are malformed and don't fit this libraries extra fields
+    {
+      PAYLOADLEN = 0;
+      unselect();
+      receiveBegin();
+      return;
+    }
+
+    DATALEN = PAYLOADLEN - 3;
+    SENDERID = SPI.transfer(0);
+    uint8_t CTLbyte = SPI.transfer(0);
+
+    ACK_RECEIVED = CTLbyte & RFM69_CTL_SENDACK; // extract ACK-received flag
+    ACK_REQUESTED = CTLbyte & RFM69_CTL_REQACK; // extract ACK-requested flag
+
+    interruptHook(CTLbyte);     // TWS: hook to derived class interrupt function
+
+    for (uint8_t i = 0; i < DATALEN; i++)
+    {
+      DATA[i] = SPI.transfer(0);
+    }
+    if (DATALEN < RF69_MAX_DATA_LEN) DATA[DATALEN] = 0; // add null at end of string
+    unselect();
+    setMode(RF69_MODE_RX);
+  }
+  RSSI = readRSSI();
+}
+
+// internal function
+void RFM69::isr0() { _inISR = true; selfPointer->interruptHandler(); _inISR = false; }
+
+// internal function
+void RFM69::receiveBegin() {
+  DATALEN = 0;
+  SENDERID = 0;
+  TARGETID = 0;
+  PAYLOADLEN = 0;
+  ACK_REQUESTED = 0;
+  ACK_RECEIVED = 0;
+  RSSI = 0;
+  if (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)
+    writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+  writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_01); // set DIO0 to "PAYLOADREADY" in receive mode
+  setMode(RF69_MODE_RX);
+}
+
+// checks if a packet was received and/or renters receive mode
+bool RFM69::receiveDone() {
+  noInterrupts(); // re-enabled in unselect() via setMode() or via receiveBegin()
+  if (_mode == RF69_MODE_RX && PAYLOADLEN > 0)
+  {
+    setMode(RF69_MODE_STANDBY); // enables interrupts
+    return true;
+  }
+  else if (_mode == RF69_MODE_RX) // already in RX no payload yet
+  {
+    interrupts(); // explicitly re-enable interrupts
+    return false;
+  }
+  receiveBegin();
+  return false;
+}
+
+// To enable encryption: radio.encrypt("ABCDEFGHIJKLMNOP");
+// To disable encryption: radio.encrypt(null) or radio.encrypt(0)
+// KEY HAS TO BE 16 bytes !!!
+void RFM69::encrypt(const char* key) {
+  setMode(RF69_MODE_STANDBY);
+  if (key != 0)
+  {
+    select();
+    SPI.transfer(REG_AESKEY1 | 0x80);
+    for (uint8_t i = 0; i < 16; i++)
+      SPI.transfer(key[i]);
+    unselect();
+  }
+  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFE) | (key ? 1 : 0));
+}
+
+// get the received signal strength indicator (RSSI)
+int16_t RFM69::readRSSI(bool forceTrigger) {
+  int16_t rssi = 0;
+  if (forceTrigger)
+  {
+    // RSSI trigger not needed if DAGC is in continuous mode
+    writeReg(REG_RSSICONFIG, RF_RSSI_START);
+    while ((readReg(REG_RSSICONFIG) & RF_RSSI_DONE) == 0x00); // wait for RSSI_Ready
+  }
+  rssi = -readReg(REG_RSSIVALUE);
+  rssi >>= 1;
+  return rssi;
+}
+
+uint8_t RFM69::readReg(uint8_t addr)
+{
+  select();
+  SPI.transfer(addr & 0x7F);
+  uint8_t regval = SPI.transfer(0);
+  unselect();
+  return regval;
+}
+
+void RFM69::writeReg(uint8_t addr, uint8_t value)
+{
+  select();
+  SPI.transfer(addr | 0x80);
+  SPI.transfer(value);
+  unselect();
+}
+
+// select the RFM69 transceiver (save SPI settings, set CS low)
+void RFM69::select() {
+  noInterrupts();
+  SPI.setDataMode(SPI_MODE0);
+  SPI.setBitOrder(MSBFIRST);
+  SPI.setClockDivider(SPI_CLOCK_DIV4); // decided to slow down from DIV2 after SPI stalling in some instances, especially visible on mega1284p when RFM69 and FLASH chip both present
+  digitalWrite(_slaveSelectPin, LOW);
+}
+
+// unselect the RFM69 transceiver (set CS high, restore SPI settings)
+void RFM69::unselect() {
+  digitalWrite(_slaveSelectPin, HIGH);
+  maybeInterrupts();
+}
+
+// true  = disable filtering to capture all frames on network
+// false = enable node/broadcast filtering to capture only frames sent to this/broadcast address
+void RFM69::promiscuous(bool onOff) {
+  _promiscuousMode = onOff;
+}
+
+// for RFM69HW only: you must call setHighPower(true) after initialize() or else transmission won't work
+void RFM69::setHighPower(bool onOff) {
+  _isRFM69HW = onOff;
+  writeReg(REG_OCP, _isRFM69HW ? RF_OCP_OFF : RF_OCP_ON);
+  if (_isRFM69HW) // turning ON
+    writeReg(REG_PALEVEL, (readReg(REG_PALEVEL) & 0x1F) | RF_PALEVEL_PA1_ON | RF_PALEVEL_PA2_ON); // enable P1 & P2 amplifier stages
+  else
+    writeReg(REG_PALEVEL, RF_PALEVEL_PA0_ON | _powerLevel); // enable P0 only
+}
+
+// internal function
+void RFM69::setHighPowerRegs(bool onOff) {
+  writeReg(REG_TESTPA1, onOff ? 0x5D : 0x55);
+  writeReg(REG_TESTPA2, onOff ? 0x7C : 0x70);
+}
+
+uint8_t RFM69::readTemperature(uint8_t calFactor) // returns centigrade
+{
+  setMode(RF69_MODE_STANDBY);
+  writeReg(REG_TEMP1, RF_TEMP1_MEAS_START);
+  while ((readReg(REG_TEMP1) & RF_TEMP1_MEAS_RUNNING));
+  return ~readReg(REG_TEMP2) + COURSE_TEMP_COEF + calFactor; // 'complement' corrects the slope, rising temp = rising val
+} // COURSE_TEMP_COEF puts reading in the ballpark, user can add additional correction
+
+// internal function: interrupts are not enabled again while in the interrupt handler
+void RFM69::maybeInterrupts()
+{
+  // Only reenable interrupts if we're not being called from the ISR
+  if (!_inISR) interrupts();
+}
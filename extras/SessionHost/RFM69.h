@@ -0,0 +1,109 @@
+// **********************************************************************************
+// RFM69 base class of the host backend
+// **********************************************************************************
+// Same interface as the RFM69 library 1.0 (LowPowerLab) that RFM69_SessionKey derives
+// from, implemented in RFM69.cpp the same way: over SPI to the registers and FIFO of the
+// simulated radio, with the frames received in the DIO0 interrupt handler.
+// **********************************************************************************
+#ifndef RFM69_h
+#define RFM69_h
+#include <Arduino.h>
+
+#define RF69_MAX_DATA_LEN		61	// to take advantage of the built in AES/CRC we want to limit the frame size to the internal FIFO size (66 bytes - 3 bytes overhead - 2 bytes crc)
+#define RF69_SPI_CS				SS
+#define RF69_IRQ_PIN			2
+#define RF69_IRQ_NUM			0
+#define CSMA_LIMIT				-90	// upper RX signal sensitivity threshold in dBm for carrier sense access
+#define RF69_MODE_SLEEP			0	// XTAL OFF
+#define RF69_MODE_STANDBY		1	// XTAL ON
+#define RF69_MODE_SYNTH			2	// PLL ON
+#define RF69_MODE_RX			3	// RX MODE
+#define RF69_MODE_TX			4	// TX MODE
+#define RF69_315MHZ				31
+#define RF69_433MHZ				43
+#define RF69_868MHZ				86
+#define RF69_915MHZ				91
+#define null					0
+#define COURSE_TEMP_COEF		-90	// puts the temperature reading in the ballpark, user can fine tune the returned value
+#define RF69_BROADCAST_ADDR		255
+#define RF69_CSMA_LIMIT_MS		1000
+#define RF69_TX_LIMIT_MS		1000
+#define RF69_FSTEP				61.03515625	// == FXOSC / 2^19 = 32MHz / 2^19 (p13 in datasheet)
+#define RFM69_CTL_SENDACK		0x80
+#define RFM69_CTL_REQACK		0x40
+#define RFM69_CTL_EXT1			0x20
+#define RFM69_CTL_EXT2			0x10
+
+class RFM69 {
+  public:
+    static volatile uint8_t DATA[RF69_MAX_DATA_LEN];	// recv/xmit buf, including header & crc bytes
+    static volatile uint8_t DATALEN;
+    static volatile uint8_t SENDERID;
+    static volatile uint8_t TARGETID;					// should match _address
+    static volatile uint8_t PAYLOADLEN;
+    static volatile uint8_t ACK_REQUESTED;
+    static volatile uint8_t ACK_RECEIVED;				// should be polled immediately after sending a packet with ACK request
+    static volatile int16_t RSSI;						// most accurate RSSI during reception (closest to the reception)
+    static volatile uint8_t _mode;						// should be protected?
+
+    RFM69(uint8_t slaveSelectPin=RF69_SPI_CS, uint8_t interruptPin=RF69_IRQ_PIN, bool isRFM69HW=false, uint8_t interruptNum=RF69_IRQ_NUM) {
+      _slaveSelectPin = slaveSelectPin;
+      _interruptPin = interruptPin;
+      _interruptNum = interruptNum;
+      _mode = RF69_MODE_STANDBY;
+      _promiscuousMode = false;
+      _powerLevel = 31;
+      _isRFM69HW = isRFM69HW;
+      _address = 0;
+      _SREG = 0;
+    }
+    virtual ~RFM69() {}
+
+    bool initialize(uint8_t freqBand, uint8_t ID, uint8_t networkID=1);
+    void setAddress(uint8_t addr);
+    void setNetwork(uint8_t networkID);
+    bool canSend();
+    virtual void send(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false);
+    virtual bool sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries=2, uint8_t retryWaitTime=40); // 40ms roundtrip req for 61byte packets
+    virtual bool receiveDone();
+    bool ACKReceived(uint8_t fromNodeID);
+    bool ACKRequested();
+    virtual void sendACK(const void* buffer = "", uint8_t bufferSize=0);
+    uint32_t getFrequency();
+    void setFrequency(uint32_t freqHz);
+    void encrypt(const char* key);
+    int16_t readRSSI(bool forceTrigger=false);
+    void promiscuous(bool onOff=true);
+    virtual void setHighPower(bool onOFF=true);		// has to be called after initialize() for RFM69HW
+    virtual void setPowerLevel(uint8_t level);			// reduce/increase transmit power level
+    void sleep();
+    uint8_t readTemperature(uint8_t calFactor=0);		// get CMOS temperature (8bit)
+    uint8_t readReg(uint8_t addr);
+    void writeReg(uint8_t addr, uint8_t val);
+
+  protected:
+    static void isr0();
+    virtual void interruptHandler();
+    virtual void interruptHook(uint8_t CTLbyte) { (void)CTLbyte; }
+    static volatile bool _inISR;
+    virtual void sendFrame(uint8_t toAddress, const void* buffer, uint8_t size, bool requestACK=false, bool sendACK=false);
+
+    static RFM69* selfPointer;
+    uint8_t _slaveSelectPin;
+    uint8_t _interruptPin;
+    uint8_t _interruptNum;
+    uint8_t _address;
+    bool _promiscuousMode;
+    uint8_t _powerLevel;
+    bool _isRFM69HW;
+    uint8_t _SREG;
+
+    virtual void receiveBegin();
+    virtual void setMode(uint8_t mode);
+    virtual void setHighPowerRegs(bool onOff);
+    virtual void select();
+    virtual void unselect();
+    inline void maybeInterrupts();
+};
+
+#endif
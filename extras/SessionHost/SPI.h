@@ -0,0 +1,39 @@
+// **********************************************************************************
+// SPI library stand-in of the host backend
+// **********************************************************************************
+// The bytes are clocked to the simulated RFM69 of the node whose NSS pin (SS) is low:
+// the first byte of a transfer is the register address (bit 7 set to write), the next
+// ones the data, read from or written to the FIFO for REG_FIFO, else auto-incremented.
+// Each byte costs its time at 4 MHz (SPI_CLOCK_DIV4, as the RFM69 library) on a 16 MHz AVR.
+// **********************************************************************************
+#ifndef SPI_h
+#define SPI_h
+#include <Arduino.h>
+
+#define SPI_MODE0			0x00
+#define SPI_CLOCK_DIV2		0x04
+#define SPI_CLOCK_DIV4		0x00
+#define MSBFIRST			1
+#define LSBFIRST			0
+
+class SPISettings {
+  public:
+    SPISettings() {}
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) { (void)clock; (void)bitOrder; (void)dataMode; }
+};
+
+class SPIClass {
+  public:
+    void begin();
+    void end();
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    void setDataMode(uint8_t mode);
+    void setBitOrder(uint8_t order);
+    void setClockDivider(uint8_t divider);
+    uint8_t transfer(uint8_t data);
+    void transfer(void* buffer, size_t count);
+};
+extern SPIClass SPI;
+
+#endif
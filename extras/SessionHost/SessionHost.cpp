@@ -0,0 +1,1187 @@
+// **********************************************************************************
+// RFM69_SessionKey host backend
+// **********************************************************************************
+// Nodes, their clocks and radios, the channel, and the Arduino, SPI and EEPROM calls of
+// the sketches (see SessionHost.h). Single threaded: the nodes are coroutines resumed by
+// hostRun() in the order of their simulated time, so a run is repeatable for a seed.
+// **********************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "SPI.h"
+#include "EEPROM.h"
+#include "RFM69registers.h"
+#include "SessionHost.h"
+
+#define FOREVER				UINT64_MAX
+#define STACK_SIZE			(256 * 1024)	// bytes of each node coroutine
+#define FIFO_SIZE			66				// bytes of the radio FIFO
+#define MODE_SLEEP			0				// RegOpMode Mode field
+#define MODE_STANDBY		1
+#define MODE_SYNTH			2
+#define MODE_TX				3
+#define MODE_RX				4
+#define IRQ_PIN				2				// DIO0 wired to INT0
+#define MAX_PINS			32
+
+// One transmission on the channel
+struct Frame {
+  uint64_t id;
+  uint64_t start;							// first preamble bit (ns)
+  uint64_t sync;							// first sync word bit: the receivers decide to receive it
+  uint64_t end;								// last CRC bit
+  int from;
+  bool aborted;								// the sender left TX mode before the end
+  double power;								// dBm at the antenna of the sender
+  uint32_t frf;								// frequency, bitrate and sync word of the sender
+  uint16_t bitrate;
+  uint8_t syncConfig;
+  uint8_t syncValue[8];
+  bool aes;
+  uint8_t aesKey[16];
+  uint8_t length;							// bytes of data: the length byte, then the payload
+  uint8_t data[FIFO_SIZE];
+};
+
+struct Node {
+  int index;
+  bool on;
+  // sketch library and coroutine
+  std::string sketch;
+  char path[64];
+  void* library;
+  void (*setup)(void);
+  void (*loop)(void);
+  ucontext_t context;
+  char* stack;
+  bool running;								// in its coroutine (may yield)
+  uint64_t now;								// ns
+  uint64_t wake;							// while parked: ns the node waits until
+  bool parked;
+  // CPU
+  bool irqOn;
+  bool inIsr;
+  bool pending;								// INT0 flag
+  void (*isr)(void);
+  int isrMode;
+  uint64_t isrCount;
+  uint64_t isrLongest;						// ns, longest interrupt handler with its entry and exit
+  uint8_t pins[MAX_PINS];
+  std::mt19937 random;
+  // Serial and EEPROM
+  std::string input;
+  size_t inputPos;
+  bool echo;
+  bool idle;
+  uint32_t baud;
+  uint8_t eeprom[HOST_EEPROM_SIZE];
+  // radio
+  uint8_t regs[0x80];
+  uint8_t fifo[FIFO_SIZE];
+  uint8_t fifoCount;
+  uint8_t fifoRead;
+  bool selected;
+  int spiAddress;							// -1: the next byte is the address
+  bool spiWrite;
+  uint8_t mode;
+  uint64_t modeReady;
+  uint64_t rxReady;
+  bool payloadReady;
+  bool packetSent;
+  bool dio0;
+  bool transmitting;
+  uint64_t txEnd;
+  uint64_t txId;
+  uint64_t txStart;
+  bool locked;								// receiving the frame lockId
+  uint64_t lockId;
+  uint64_t lockStart;
+  uint64_t lockEnd;
+  double lockPower;
+  uint64_t seenSync;						// the frames up to (seenSync, seenId) were considered
+  uint64_t seenId;
+  double rssiPacket;						// RSSI of the frame received, read until rssiUntil
+  uint64_t rssiUntil;
+  uint8_t rssiValue;
+};
+
+static HostChannel channel;
+static HostChannelStats channelStats;
+static std::vector<Node*> nodes;
+static double pathLoss[HOST_MAX_NODES][HOST_MAX_NODES];	// NAN: channel.pathLoss
+static double linkLoss[HOST_MAX_NODES][HOST_MAX_NODES];
+static std::deque<Frame> frames;			// sorted by start
+static uint64_t frameIds;
+static uint64_t maxAir;						// longest frame (ns), to find the overlapping ones
+static uint64_t maxPreamble;
+static std::mt19937 lossRandom;
+static Node* cur;							// node running
+static ucontext_t hostContext;
+static uint64_t horizon;					// the node running yields once its time reaches it
+static uint64_t worldTime;
+static char tempDir[64];
+static uint32_t loads;
+
+HardwareSerial Serial;
+SPIClass SPI;
+EEPROMClass EEPROM;
+
+//=============================================================================
+// Channel
+//=============================================================================
+static double txPower(const Node& n)
+{
+  uint8_t pa = n.regs[REG_PALEVEL];
+  int level = pa & 0x1F;
+  if (pa & RF_PALEVEL_PA0_ON) return -18 + level;
+  if ((pa & RF_PALEVEL_PA1_ON) && (pa & RF_PALEVEL_PA2_ON)) return (n.regs[REG_TESTPA1] == 0x5D ? -11 : -14) + level;
+  return -18 + level;
+}
+
+static double linkPower(const Frame& f, int to)
+{
+  double loss = pathLoss[f.from][to];
+  return f.power - (isnan(loss) ? channel.pathLoss : loss);
+}
+
+static double milliwatts(double dBm)
+{
+  return pow(10, dBm / 10);
+}
+
+static uint64_t bitTime(uint16_t bitrate)
+{
+  return (uint64_t)bitrate * 1000 / 32;	// 32 MHz / bitrate register
+}
+
+static uint64_t preambleTime(const Node& n)
+{
+  return (((uint16_t)n.regs[REG_PREAMBLEMSB] << 8) | n.regs[REG_PREAMBLELSB]) * 8 * bitTime(((uint16_t)n.regs[REG_BITRATEMSB] << 8) | n.regs[REG_BITRATELSB]);
+}
+
+// first frame (in the deque order) that may start at or after time
+static size_t firstFrom(uint64_t time)
+{
+  size_t lo = 0, hi = frames.size();
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    if (frames[mid].start < time) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static Frame* findFrame(uint64_t start, uint64_t id)
+{
+  for (size_t i = firstFrom(start); i < frames.size() && frames[i].start == start; i++)
+    if (frames[i].id == id) return &frames[i];
+  return NULL;
+}
+
+static double channelPower(const Node& n, uint64_t time)
+{
+  double mw = milliwatts(channel.noise);
+  uint32_t frf = ((uint32_t)n.regs[REG_FRFMSB] << 16) | ((uint32_t)n.regs[REG_FRFMID] << 8) | n.regs[REG_FRFLSB];
+  for (size_t i = firstFrom(time > maxAir ? time - maxAir : 0); i < frames.size() && frames[i].start <= time; i++)
+  {
+    const Frame& f = frames[i];
+    if (f.from != n.index && f.end > time && f.frf == frf) mw += milliwatts(linkPower(f, n.index));
+  }
+  return 10 * log10(mw);
+}
+
+//=============================================================================
+// Radio
+//=============================================================================
+static void dioUpdate(Node& n)
+{
+  uint8_t map = n.regs[REG_DIOMAPPING1] >> 6;
+  bool level = (n.mode == MODE_RX && map <= 1 && n.payloadReady) || (n.mode == MODE_TX && map == 0 && n.packetSent);
+  if (level && !n.dio0 && n.isr != NULL && (n.isrMode == RISING || n.isrMode == CHANGE)) n.pending = true;
+  if (!level && n.dio0 && n.isr != NULL && (n.isrMode == FALLING || n.isrMode == CHANGE)) n.pending = true;
+  n.dio0 = level;
+}
+
+static void clearFifo(Node& n)
+{
+  n.fifoCount = 0;
+  n.fifoRead = 0;
+  n.payloadReady = false;
+}
+
+static void rxRestart(Node& n, uint64_t delay)
+{
+  n.locked = false;
+  clearFifo(n);
+  n.rxReady = n.now + delay;
+  if (n.rssiUntil == FOREVER) n.rssiUntil = n.rxReady;	// the RSSI of the last frame is read until a new measure
+  dioUpdate(n);
+}
+
+static void startTx(Node& n)
+{
+  Frame f;
+  f.id = ++frameIds;
+  f.from = n.index;
+  f.aborted = false;
+  f.power = txPower(n);
+  f.frf = ((uint32_t)n.regs[REG_FRFMSB] << 16) | ((uint32_t)n.regs[REG_FRFMID] << 8) | n.regs[REG_FRFLSB];
+  f.bitrate = ((uint16_t)n.regs[REG_BITRATEMSB] << 8) | n.regs[REG_BITRATELSB];
+  f.syncConfig = n.regs[REG_SYNCCONFIG];
+  memcpy(f.syncValue, &n.regs[REG_SYNCVALUE1], sizeof(f.syncValue));
+  f.aes = n.regs[REG_PACKETCONFIG2] & RF_PACKET2_AES_ON;
+  memcpy(f.aesKey, &n.regs[REG_AESKEY1], sizeof(f.aesKey));
+  uint8_t count = n.fifoCount - n.fifoRead;
+  f.length = count == 0 ? 0 : std::min<uint8_t>(count, 1 + n.fifo[n.fifoRead]);
+  memcpy(f.data, n.fifo + n.fifoRead, f.length);
+  clearFifo(n);
+  uint8_t payload = f.length > 0 ? f.length - 1 : 0;
+  if (f.aes) payload = (payload + 15) / 16 * 16;
+  uint8_t syncSize = (f.syncConfig & RF_SYNC_ON) ? ((f.syncConfig >> 3) & 7) + 1 : 0;
+  uint32_t bytes = (((uint16_t)n.regs[REG_PREAMBLEMSB] << 8) | n.regs[REG_PREAMBLELSB]) + syncSize + 1 + payload +
+                   ((n.regs[REG_PACKETCONFIG1] & RF_PACKET1_CRC_ON) ? 2 : 0);
+  f.start = n.now + HOST_TX_START_NS;
+  f.sync = f.start + preambleTime(n);
+  f.end = f.start + bytes * 8 * bitTime(f.bitrate);
+  maxAir = std::max(maxAir, f.end - f.start);
+  maxPreamble = std::max(maxPreamble, f.sync - f.start);
+  size_t pos = frames.size();
+  while (pos > 0 && frames[pos - 1].start > f.start) pos--;
+  frames.insert(frames.begin() + pos, f);
+  channelStats.frames++;
+  n.transmitting = true;
+  n.txId = f.id;
+  n.txStart = f.start;
+  n.txEnd = f.end;
+  // a parked receiver wakes up at the end of a frame it may receive, the others see it when they get there
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    Node& q = *nodes[i];
+    if (&q == &n || !q.on || !q.parked || q.mode != MODE_RX || linkPower(f, q.index) < channel.sensitivity) continue;
+    if (f.end < q.wake) q.wake = f.end;
+    if (f.end + HOST_TX_START_NS < horizon) horizon = f.end + HOST_TX_START_NS;
+  }
+}
+
+static void abortTx(Node& n)
+{
+  if (!n.transmitting) return;
+  Frame* f = findFrame(n.txStart, n.txId);
+  if (f != NULL && n.now < f->end)
+  {
+    f->aborted = true;
+    f->end = std::max(n.now, f->start);
+  }
+  n.transmitting = false;
+}
+
+static void setRadioMode(Node& n, uint8_t mode)
+{
+  if (mode > MODE_RX) mode = MODE_STANDBY;
+  if (mode == n.mode) return;
+  uint8_t old = n.mode;
+  if (old == MODE_TX)
+  {
+    abortTx(n);
+    n.packetSent = false;
+  }
+  if (old == MODE_RX) n.locked = false;	// the frame being received is lost
+  n.mode = mode;
+  n.modeReady = n.now + (old == MODE_SLEEP ? HOST_OSC_START_NS : 0);
+  if (mode == MODE_RX)
+  {
+    rxRestart(n, (n.modeReady - n.now) + HOST_RX_START_NS);
+    n.seenSync = n.now;
+    n.seenId = FOREVER;
+  }
+  if (mode == MODE_TX && n.fifoCount > n.fifoRead) startTx(n);
+  dioUpdate(n);
+}
+
+static bool sameSync(const Frame& f, const Node& n)
+{
+  uint8_t config = n.regs[REG_SYNCCONFIG];
+  if ((config & 0xF8) != (f.syncConfig & 0xF8)) return false;
+  if (!(config & RF_SYNC_ON)) return true;
+  return memcmp(f.syncValue, &n.regs[REG_SYNCVALUE1], ((config >> 3) & 7) + 1) == 0;
+}
+
+static void tryLock(Node& n, const Frame& f)
+{
+  if (f.from == n.index || f.aborted || n.locked || n.payloadReady || n.rxReady > f.sync) return;
+  uint32_t frf = ((uint32_t)n.regs[REG_FRFMSB] << 16) | ((uint32_t)n.regs[REG_FRFMID] << 8) | n.regs[REG_FRFLSB];
+  uint16_t bitrate = ((uint16_t)n.regs[REG_BITRATEMSB] << 8) | n.regs[REG_BITRATELSB];
+  if (f.frf != frf || f.bitrate != bitrate || !sameSync(f, n)) return;
+  double power = linkPower(f, n.index);
+  if (power < channel.sensitivity) return;
+  n.locked = true;
+  n.lockId = f.id;
+  n.lockStart = f.start;
+  n.lockEnd = f.end;
+  n.lockPower = power;
+}
+
+static void finishReception(Node& n)
+{
+  n.locked = false;
+  Frame* f = findFrame(n.lockStart, n.lockId);
+  if (f == NULL || f->aborted) return;
+  double mw = milliwatts(channel.noise);
+  for (size_t i = firstFrom(f->start > maxAir ? f->start - maxAir : 0); i < frames.size() && frames[i].start < f->end; i++)
+  {
+    const Frame& g = frames[i];
+    if (&g != f && g.from != n.index && g.end > f->start && g.frf == f->frf) mw += milliwatts(linkPower(g, n.index));
+  }
+  if (n.lockPower - 10 * log10(mw) < channel.capture)
+  {
+    channelStats.collisions++;
+    return;
+  }
+  double loss = linkLoss[f->from][n.index];
+  if (loss > 0 && std::uniform_real_distribution<double>(0, 1)(lossRandom) < loss)
+  {
+    channelStats.losses++;
+    return;
+  }
+  memcpy(n.fifo, f->data, f->length);
+  bool aes = n.regs[REG_PACKETCONFIG2] & RF_PACKET2_AES_ON;
+  if (aes != f->aes || (aes && memcmp(f->aesKey, &n.regs[REG_AESKEY1], sizeof(f->aesKey)) != 0))
+    for (uint8_t i = 1; i < f->length; i++) n.fifo[i] ^= 0xA5 + 31 * i;	// decrypted with another key
+  n.fifoCount = f->length;
+  n.fifoRead = 0;
+  n.payloadReady = f->length > 0;
+  n.rssiPacket = n.lockPower;
+  n.rssiUntil = FOREVER;
+  channelStats.received++;
+  dioUpdate(n);
+}
+
+// next frame whose sync word starts after (seenSync, seenId), up to time
+static const Frame* nextSync(const Node& n, uint64_t time)
+{
+  const Frame* next = NULL;
+  for (size_t i = firstFrom(n.seenSync > maxPreamble ? n.seenSync - maxPreamble : 0); i < frames.size() && frames[i].start <= time; i++)
+  {
+    const Frame& f = frames[i];
+    if (f.sync > time || f.sync < n.seenSync || (f.sync == n.seenSync && f.id <= n.seenId)) continue;
+    if (next == NULL || f.sync < next->sync || (f.sync == next->sync && f.id < next->id)) next = &f;
+  }
+  return next;
+}
+
+// Bring the radio of a node to its time: end of its transmission, frames received
+static void radioUpdate(Node& n)
+{
+  if (n.transmitting && n.now >= n.txEnd)
+  {
+    n.transmitting = false;
+    n.packetSent = true;
+    dioUpdate(n);
+  }
+  if (n.mode != MODE_RX)
+  {
+    n.seenSync = n.now;
+    n.seenId = FOREVER;
+    return;
+  }
+  for (;;)
+  {
+    const Frame* next = nextSync(n, n.now);
+    if (n.locked && n.lockEnd <= n.now && (next == NULL || n.lockEnd <= next->sync))
+    {
+      finishReception(n);
+      continue;
+    }
+    if (next == NULL) break;
+    n.seenSync = next->sync;
+    n.seenId = next->id;
+    tryLock(n, *next);
+  }
+}
+
+// Time of the next radio event of a node waiting: end of its frame or of a frame it may receive
+static uint64_t radioEvent(const Node& n)
+{
+  uint64_t event = n.transmitting ? n.txEnd : FOREVER;
+  if (n.mode != MODE_RX) return event;
+  if (n.locked) event = std::min(event, n.lockEnd);
+  for (size_t i = firstFrom(n.seenSync > maxPreamble ? n.seenSync - maxPreamble : 0); i < frames.size(); i++)
+  {
+    const Frame& f = frames[i];
+    if (f.from != n.index && (f.sync > n.seenSync || (f.sync == n.seenSync && f.id > n.seenId)) && linkPower(f, n.index) >= channel.sensitivity)
+      event = std::min(event, f.end);
+  }
+  return event;
+}
+
+static uint8_t readRegister(Node& n, uint8_t address)
+{
+  switch (address)
+  {
+    case REG_FIFO:
+      if (n.fifoRead >= n.fifoCount) return 0;
+      {
+        uint8_t value = n.fifo[n.fifoRead++];
+        if (n.fifoRead >= n.fifoCount)
+        {
+          // FIFO empty: PayloadReady cleared, the receiver restarts (AutoRxRestartOn)
+          bool ready = n.payloadReady;
+          clearFifo(n);
+          if (ready && n.mode == MODE_RX && (n.regs[REG_PACKETCONFIG2] & RF_PACKET2_AUTORXRESTART_ON))
+            rxRestart(n, 2 * bitTime(((uint16_t)n.regs[REG_BITRATEMSB] << 8) | n.regs[REG_BITRATELSB]));
+          dioUpdate(n);
+        }
+        return value;
+      }
+    case REG_RSSICONFIG:
+      return RF_RSSI_DONE;
+    case REG_RSSIVALUE:
+      if (n.mode == MODE_RX)
+      {
+        double dBm = n.now < n.rssiUntil ? n.rssiPacket : channelPower(n, n.now);
+        n.rssiValue = (uint8_t)std::max(0.0, std::min(255.0, -2 * dBm));
+      }
+      return n.rssiValue;
+    case REG_IRQFLAGS1:
+      return (n.now >= n.modeReady ? RF_IRQFLAGS1_MODEREADY : 0) | (n.mode == MODE_RX && n.now >= n.rxReady ? RF_IRQFLAGS1_RXREADY : 0) |
+             (n.mode == MODE_TX ? RF_IRQFLAGS1_TXREADY : 0);
+    case REG_IRQFLAGS2:
+      return (n.fifoRead < n.fifoCount ? RF_IRQFLAGS2_FIFONOTEMPTY : 0) | (n.packetSent ? RF_IRQFLAGS2_PACKETSENT : 0) |
+             (n.payloadReady ? RF_IRQFLAGS2_PAYLOADREADY : 0);
+    case REG_TEMP1:
+      return 0;
+    case REG_TEMP2:
+      return 0x8C;										// about 25 C with COURSE_TEMP_COEF
+    default:
+      return n.regs[address];
+  }
+}
+
+static void writeRegister(Node& n, uint8_t address, uint8_t value)
+{
+  switch (address)
+  {
+    case REG_FIFO:
+      if (n.payloadReady) clearFifo(n);				// a frame received and not read is overwritten
+      if (n.fifoCount < FIFO_SIZE) n.fifo[n.fifoCount++] = value;
+      break;
+    case REG_OPMODE:
+      n.regs[address] = value;
+      setRadioMode(n, (value >> 2) & 7);
+      break;
+    case REG_IRQFLAGS2:
+      if (value & RF_IRQFLAGS2_FIFOOVERRUN) clearFifo(n);
+      dioUpdate(n);
+      break;
+    case REG_PACKETCONFIG2:
+      n.regs[address] = value & ~RF_PACKET2_RXRESTART;
+      if ((value & RF_PACKET2_RXRESTART) && n.mode == MODE_RX)
+        rxRestart(n, 2 * bitTime(((uint16_t)n.regs[REG_BITRATEMSB] << 8) | n.regs[REG_BITRATELSB]));
+      break;
+    case REG_DIOMAPPING1:
+      n.regs[address] = value;
+      dioUpdate(n);
+      break;
+    case REG_VERSION:
+    case REG_IRQFLAGS1:
+    case REG_RSSIVALUE:
+      break;
+    default:
+      n.regs[address] = value;
+  }
+}
+
+static void resetRadio(Node& n)
+{
+  static const uint8_t defaults[][2] =
+  {
+    { REG_OPMODE, 0x04 }, { REG_BITRATEMSB, 0x1A }, { REG_BITRATELSB, 0x0B }, { REG_FDEVMSB, 0x00 }, { REG_FDEVLSB, 0x52 },
+    { REG_FRFMSB, 0xE4 }, { REG_FRFMID, 0xC0 }, { REG_VERSION, 0x24 }, { REG_PALEVEL, 0x9F }, { REG_OCP, 0x1A },
+    { REG_RXBW, 0x55 }, { REG_DIOMAPPING2, 0x05 }, { REG_RSSITHRESH, 0xE4 }, { REG_PREAMBLELSB, 0x03 },
+    { REG_SYNCCONFIG, 0x98 }, { REG_SYNCVALUE1, 0x01 }, { REG_SYNCVALUE1 + 1, 0x01 }, { REG_SYNCVALUE1 + 2, 0x01 },
+    { REG_SYNCVALUE1 + 3, 0x01 }, { REG_PACKETCONFIG1, 0x10 }, { REG_PAYLOADLENGTH, 0x40 }, { REG_FIFOTHRESH, 0x8F },
+    { REG_PACKETCONFIG2, 0x02 }, { REG_TESTPA1, 0x55 }, { REG_TESTPA2, 0x70 }, { REG_TESTDAGC, 0x30 }
+  };
+  memset(n.regs, 0, sizeof(n.regs));
+  for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) n.regs[defaults[i][0]] = defaults[i][1];
+  n.mode = MODE_STANDBY;
+  n.modeReady = n.now + HOST_OSC_START_NS;			// power on
+  n.rxReady = FOREVER;
+  clearFifo(n);
+  n.selected = false;
+  n.spiAddress = -1;
+  n.packetSent = false;
+  n.dio0 = false;
+  n.transmitting = false;
+  n.locked = false;
+  n.seenSync = n.now;
+  n.seenId = FOREVER;
+  n.rssiUntil = 0;
+  n.rssiValue = 0xFF;
+}
+
+//=============================================================================
+// Coroutines and time
+//=============================================================================
+static void sync(Node& n);
+
+static void yieldNode(Node& n)
+{
+  swapcontext(&n.context, &hostContext);
+  cur = &n;
+}
+
+// The radio and the pending interrupt are brought to the time of the node; a node running
+// ahead of the others by the TX start up time gives them a turn first
+static void sync(Node& n)
+{
+  for (;;)
+  {
+    while (n.running && n.now >= horizon) yieldNode(n);
+    radioUpdate(n);
+    if (!(n.pending && n.irqOn && !n.inIsr && n.isr != NULL)) return;
+    n.pending = false;
+    n.inIsr = true;
+    n.irqOn = false;
+    n.isrCount++;
+    uint64_t start = n.now;
+    n.now += HOST_ISR_NS;
+    n.isr();
+    n.isrLongest = std::max(n.isrLongest, n.now - start);
+    n.inIsr = false;
+    n.irqOn = true;
+  }
+}
+
+static void advance(uint64_t ns)
+{
+  if (cur == NULL) return;
+  cur->now += ns;
+  sync(*cur);
+}
+
+// Wait until time, the interrupts are served meanwhile; with wakeOnEvent, return after the
+// first one or once Serial input is there
+static void park(uint64_t until, bool wakeOnEvent)
+{
+  Node& n = *cur;
+  uint64_t isrCount = n.isrCount;
+  sync(n);
+  while (n.now < until && !(wakeOnEvent && (n.isrCount != isrCount || n.inputPos < n.input.size())))
+  {
+    n.wake = std::min(until, radioEvent(n));
+    if (n.wake > n.now && n.running)
+    {
+      n.parked = true;
+      yieldNode(n);
+      n.parked = false;
+    }
+    else if (!n.running) n.now = n.wake;
+    sync(n);
+  }
+}
+
+static void nodeMain()
+{
+  Node& n = *cur;
+  n.setup();
+  for (;;)
+  {
+    n.loop();
+    advance(HOST_LOOP_NS);
+    if (n.inputPos >= n.input.size()) n.idle = true;
+  }
+}
+
+static void powerOff(Node& n)
+{
+  if (!n.on) return;
+  abortTx(n);
+  n.on = false;
+  n.parked = false;
+  if (n.library != NULL) dlclose(n.library);
+  n.library = NULL;
+  unlink(n.path);
+  free(n.stack);
+  n.stack = NULL;
+}
+
+static bool copyFile(const char* from, const char* to)
+{
+  FILE* in = fopen(from, "rb");
+  if (in == NULL) return false;
+  FILE* out = fopen(to, "wb");
+  if (out == NULL)
+  {
+    fclose(in);
+    return false;
+  }
+  char buffer[65536];
+  size_t count;
+  bool ok = true;
+  while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    if (fwrite(buffer, 1, count, out) != count) ok = false;
+  fclose(in);
+  if (fclose(out) != 0) ok = false;
+  return ok;
+}
+
+// A fresh copy of the sketch library: dlopen() of another file gives other static variables
+static bool powerOn(Node& n, const char* sketch)
+{
+  if (n.on) return true;
+  if (tempDir[0] == 0)
+  {
+    strcpy(tempDir, "/tmp/session-host-XXXXXX");
+    if (mkdtemp(tempDir) == NULL)
+    {
+      tempDir[0] = 0;
+      fprintf(stderr, "session host: no temporary directory\n");
+      return false;
+    }
+  }
+  snprintf(n.path, sizeof(n.path), "%s/node%d-%u.so", tempDir, n.index, ++loads);
+  if (!copyFile(sketch, n.path))
+  {
+    fprintf(stderr, "session host: cannot copy %s\n", sketch);
+    return false;
+  }
+  n.now = worldTime;
+  n.parked = false;
+  n.running = false;
+  n.irqOn = true;
+  n.inIsr = false;
+  n.pending = false;
+  n.isr = NULL;
+  n.isrCount = 0;
+  n.isrLongest = 0;
+  memset(n.pins, 0, sizeof(n.pins));
+  n.idle = false;
+  n.baud = 0;
+  resetRadio(n);
+  Node* caller = cur;
+  cur = &n;												// the static constructors of the sketch run on the node
+  n.library = dlopen(n.path, RTLD_NOW | RTLD_LOCAL);
+  cur = caller;
+  if (n.library == NULL)
+  {
+    fprintf(stderr, "session host: %s\n", dlerror());
+    unlink(n.path);
+    return false;
+  }
+  n.setup = (void (*)(void))dlsym(n.library, "setup");
+  n.loop = (void (*)(void))dlsym(n.library, "loop");
+  if (n.setup == NULL || n.loop == NULL)
+  {
+    fprintf(stderr, "session host: %s has no setup() and loop()\n", sketch);
+    dlclose(n.library);
+    n.library = NULL;
+    unlink(n.path);
+    return false;
+  }
+  n.stack = (char*)malloc(STACK_SIZE);
+  getcontext(&n.context);
+  n.context.uc_stack.ss_sp = n.stack;
+  n.context.uc_stack.ss_size = STACK_SIZE;
+  n.context.uc_link = NULL;
+  makecontext(&n.context, nodeMain, 0);
+  n.on = true;
+  return true;
+}
+
+static uint64_t nodeTime(const Node& n)
+{
+  return n.parked ? n.wake : n.now;
+}
+
+// Drop the frames no node can look at anymore
+static void collectFrames()
+{
+  uint64_t oldest = FOREVER;
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    const Node& n = *nodes[i];
+    if (!n.on) continue;
+    uint64_t t = n.parked && n.mode != MODE_RX ? n.wake : n.now;
+    if (n.mode == MODE_RX)
+    {
+      t = std::min(t, n.seenSync > maxPreamble ? n.seenSync - maxPreamble : 0);
+      if (n.locked) t = std::min(t, n.lockStart);
+    }
+    oldest = std::min(oldest, t);
+  }
+  while (!frames.empty() && frames.front().end + maxAir < oldest) frames.pop_front();
+}
+
+//=============================================================================
+// Host program side
+//=============================================================================
+void hostBegin(const HostChannel& config)
+{
+  hostEnd();
+  channel = config;
+  memset(&channelStats, 0, sizeof(channelStats));
+  for (int i = 0; i < HOST_MAX_NODES; i++)
+    for (int j = 0; j < HOST_MAX_NODES; j++)
+    {
+      pathLoss[i][j] = NAN;
+      linkLoss[i][j] = 0;
+    }
+  frames.clear();
+  frameIds = 0;
+  maxAir = 0;
+  maxPreamble = 0;
+  lossRandom.seed(config.seed);
+  worldTime = 0;
+}
+
+int hostNode(const char* sketch)
+{
+  if (nodes.size() >= HOST_MAX_NODES)
+  {
+    fprintf(stderr, "session host: more than %d nodes\n", HOST_MAX_NODES);
+    return -1;
+  }
+  Node* n = new Node();
+  n->index = nodes.size();
+  n->on = false;
+  n->library = NULL;
+  n->stack = NULL;
+  n->echo = false;
+  n->inputPos = 0;
+  n->random.seed(channel.seed * 1000003u + n->index);
+  memset(n->eeprom, 0xFF, sizeof(n->eeprom));
+  nodes.push_back(n);
+  if (!powerOn(*n, sketch))
+  {
+    nodes.pop_back();
+    delete n;
+    return -1;
+  }
+  n->sketch = sketch;
+  return n->index;
+}
+
+void hostPathLoss(int from, int to, double dB)
+{
+  pathLoss[from][to] = dB;
+}
+
+void hostLinkLoss(int from, int to, double probability)
+{
+  linkLoss[from][to] = probability;
+}
+
+void hostInput(int node, const char* text)
+{
+  Node& n = *nodes[node];
+  n.input.append(text);
+  n.idle = false;
+  if (n.parked && n.wake > worldTime) n.wake = std::max(n.now, worldTime);	// hostSleep() returns
+}
+
+void hostEcho(int node, bool echo)
+{
+  nodes[node]->echo = echo;
+}
+
+void hostPower(int node, bool on)
+{
+  Node& n = *nodes[node];
+  if (!on) powerOff(n);
+  else powerOn(n, n.sketch.c_str());
+}
+
+bool hostIdle(int node)
+{
+  return nodes[node]->idle;
+}
+
+uint32_t hostIsrTime(int node)
+{
+  return nodes[node]->isrLongest / 1000;
+}
+
+void hostRun(uint64_t until)
+{
+  uint64_t end = until * 1000;
+  uint32_t turns = 0;
+  for (;;)
+  {
+    Node* next = NULL;
+    uint64_t first = FOREVER, second = FOREVER;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+      Node* n = nodes[i];
+      if (!n->on) continue;
+      uint64_t t = nodeTime(*n);
+      if (t < first)
+      {
+        second = first;
+        first = t;
+        next = n;
+      }
+      else if (t < second) second = t;
+    }
+    if (next == NULL || first >= end) break;
+    horizon = std::min(second == FOREVER ? FOREVER : second + HOST_TX_START_NS, end);
+    if (next->parked) next->now = std::max(next->now, next->wake);
+    cur = next;
+    next->running = true;
+    swapcontext(&hostContext, &next->context);
+    next->running = false;
+    cur = NULL;
+    if (++turns % 4096 == 0) collectFrames();
+  }
+  collectFrames();
+  if (end > worldTime) worldTime = end;
+}
+
+uint64_t hostTime()
+{
+  return worldTime / 1000;
+}
+
+HostChannelStats hostChannelStats()
+{
+  return channelStats;
+}
+
+void hostEnd()
+{
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    powerOff(*nodes[i]);
+    delete nodes[i];
+  }
+  nodes.clear();
+  frames.clear();
+  if (tempDir[0] != 0) rmdir(tempDir);
+  tempDir[0] = 0;
+}
+
+int hostNodeIndex()
+{
+  return cur != NULL ? cur->index : -1;
+}
+
+//=============================================================================
+// Arduino core
+//=============================================================================
+unsigned long millis(void)
+{
+  advance(HOST_MILLIS_NS);
+  return cur != NULL ? cur->now / 1000000 : 0;
+}
+
+unsigned long micros(void)
+{
+  advance(HOST_MICROS_NS);
+  return cur != NULL ? cur->now / 1000 : 0;
+}
+
+void delay(unsigned long ms)
+{
+  if (cur != NULL) park(cur->now + (uint64_t)ms * 1000000, false);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  if (cur != NULL) park(cur->now + (uint64_t)us * 1000, false);
+}
+
+void hostSleep(unsigned long ms)
+{
+  if (cur != NULL) park(cur->now + (uint64_t)ms * 1000000, true);
+}
+
+void yield(void)
+{
+  advance(HOST_LOOP_NS);
+}
+
+void noInterrupts(void)
+{
+  if (cur != NULL) cur->irqOn = false;
+  advance(HOST_IRQ_NS);
+}
+
+void interrupts(void)
+{
+  if (cur != NULL) cur->irqOn = true;
+  advance(HOST_IRQ_NS);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+  advance(HOST_PIN_NS);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  advance(HOST_PIN_NS);
+  if (cur == NULL || pin >= MAX_PINS) return;
+  cur->pins[pin] = value;
+  if (pin == SS)
+  {
+    cur->selected = value == LOW;
+    cur->spiAddress = -1;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  advance(HOST_PIN_NS);
+  if (cur == NULL || pin >= MAX_PINS) return LOW;
+  if (pin == IRQ_PIN) return cur->dio0 ? HIGH : LOW;
+  return cur->pins[pin];
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*handler)(void), int mode)
+{
+  if (cur == NULL || interruptNum != digitalPinToInterrupt(IRQ_PIN)) return;
+  cur->isr = handler;
+  cur->isrMode = mode;
+  cur->pending = false;
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+  if (cur != NULL && interruptNum == digitalPinToInterrupt(IRQ_PIN)) cur->isr = NULL;
+}
+
+long random(long howBig)
+{
+  advance(HOST_RANDOM_NS);
+  if (howBig <= 0 || cur == NULL) return 0;
+  return (long)(cur->random() % (unsigned long)howBig);
+}
+
+long random(long howSmall, long howBig)
+{
+  if (howSmall >= howBig) return howSmall;
+  return random(howBig - howSmall) + howSmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed != 0 && cur != NULL) cur->random.seed(seed);
+}
+
+//=============================================================================
+// Serial
+//=============================================================================
+void HardwareSerial::begin(unsigned long baud)
+{
+  if (cur != NULL) cur->baud = baud;
+}
+
+void HardwareSerial::end()
+{
+}
+
+int HardwareSerial::available()
+{
+  advance(HOST_LOOP_NS);
+  return cur != NULL ? cur->input.size() - cur->inputPos : 0;
+}
+
+int HardwareSerial::peek()
+{
+  if (cur == NULL || cur->inputPos >= cur->input.size()) return -1;
+  return (uint8_t)cur->input[cur->inputPos];
+}
+
+int HardwareSerial::read()
+{
+  advance(HOST_LOOP_NS);
+  if (cur == NULL || cur->inputPos >= cur->input.size()) return -1;
+  cur->idle = false;
+  return (uint8_t)cur->input[cur->inputPos++];
+}
+
+void HardwareSerial::flush()
+{
+  if (cur != NULL) fflush(stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+  if (cur == NULL) return 0;
+  if (cur->echo) fwrite(buffer, 1, size, stdout);
+  if (cur->baud > 0) advance(size * 10000000000ULL / cur->baud);	// 10 bits per byte, written as fast as they go out
+  return size;
+}
+
+size_t HardwareSerial::write(uint8_t value)
+{
+  return write(&value, 1);
+}
+
+size_t HardwareSerial::write(const char* string)
+{
+  return write((const uint8_t*)string, strlen(string));
+}
+
+size_t HardwareSerial::print(const char* string)
+{
+  return write(string);
+}
+
+size_t HardwareSerial::print(char value)
+{
+  return write((uint8_t)value);
+}
+
+size_t HardwareSerial::print(unsigned long value, int base)
+{
+  char digits[8 * sizeof(long) + 1];
+  char* p = digits + sizeof(digits) - 1;
+  *p = 0;
+  if (base < 2) base = 10;
+  do
+  {
+    int digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  return write(p);
+}
+
+size_t HardwareSerial::print(long value, int base)
+{
+  if (base == DEC && value < 0) return print('-') + print((unsigned long)-value, base);
+  return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(unsigned char value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(int value, int base)
+{
+  return print((long)value, base);
+}
+
+size_t HardwareSerial::print(unsigned int value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(double value, int digits)
+{
+  char text[64];
+  if (isnan(value)) return write("nan");
+  if (isinf(value)) return write("inf");
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t HardwareSerial::println()
+{
+  return write("\r\n");
+}
+
+//=============================================================================
+// SPI
+//=============================================================================
+void SPIClass::begin()
+{
+}
+
+void SPIClass::end()
+{
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+  (void)settings;
+}
+
+void SPIClass::endTransaction()
+{
+}
+
+void SPIClass::setDataMode(uint8_t mode)
+{
+  (void)mode;
+}
+
+void SPIClass::setBitOrder(uint8_t order)
+{
+  (void)order;
+}
+
+void SPIClass::setClockDivider(uint8_t divider)
+{
+  (void)divider;
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  advance(HOST_SPI_BYTE_NS);
+  if (cur == NULL || !cur->selected) return 0xFF;
+  Node& n = *cur;
+  if (n.spiAddress < 0)
+  {
+    n.spiAddress = data & 0x7F;
+    n.spiWrite = data & 0x80;
+    return 0;
+  }
+  uint8_t address = n.spiAddress;
+  if (address != REG_FIFO) n.spiAddress = (address + 1) & 0x7F;	// burst access, the FIFO address does not move
+  if (n.spiWrite)
+  {
+    writeRegister(n, address, data);
+    return 0;
+  }
+  return readRegister(n, address);
+}
+
+void SPIClass::transfer(void* buffer, size_t count)
+{
+  uint8_t* p = (uint8_t*)buffer;
+  for (size_t i = 0; i < count; i++) p[i] = transfer(p[i]);
+}
+
+//=============================================================================
+// EEPROM
+//=============================================================================
+uint8_t EEPROMClass::read(int address)
+{
+  advance(HOST_EEPROM_READ_NS);
+  if (cur == NULL) return 0xFF;
+  return cur->eeprom[(unsigned)address % HOST_EEPROM_SIZE];
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+  if (cur == NULL) return;
+  cur->eeprom[(unsigned)address % HOST_EEPROM_SIZE] = value;
+  park(cur->now + HOST_EEPROM_WRITE_NS, false);
+}
+
+void EEPROMClass::update(int address, uint8_t value)
+{
+  if (read(address) != value) write(address, value);
+}
+
+uint16_t EEPROMClass::length()
+{
+  return HOST_EEPROM_SIZE;
+}
@@ -0,0 +1,89 @@
+// **********************************************************************************
+// RFM69_SessionKey host backend
+// **********************************************************************************
+// Runs Arduino sketches built with RFM69_SessionKey on simulated nodes sharing one radio
+// channel, on Linux, so a change of the library is measured without flashing any node:
+//   - each node loads its own copy of a sketch library: the sketch, RFM69_SessionKey.cpp,
+//     RFM69_SessionMac.cpp and RFM69.cpp of this directory, with the Arduino.h, SPI.h,
+//     EEPROM.h, RFM69.h and RFM69registers.h stand-ins of this directory. Every node thus
+//     has its own static state of the classes; setup() then loop() run in a coroutine
+//   - time: each node has its own clock, advanced by the Arduino, SPI and EEPROM calls (the
+//     time they take on a 16 MHz ATmega328, HOST_xxx_NS below) and by delay(). A node never
+//     runs more than the TX start up time ahead of the others: whatever it sends reaches the
+//     channel after all the others went past it, so the nodes see the same channel as if they
+//     ran in parallel. millis() and micros() do not wrap (unsigned long is 64 bits on the host)
+//   - radio: SX1231 registers, 66 bytes FIFO, packet engine in variable length mode, DIO0 on
+//     PayloadReady (RX) or PacketSent (TX) raising the interrupt attached to pin 2, RSSI of
+//     the channel, RX and TX start up times
+//   - channel: air time at the bitrate of the registers of the sender (preamble, sync word,
+//     length, payload padded to 16 bytes with AES, CRC); a frame is received if the receiver
+//     was in RX before its preamble ended, with the same frequency, bitrate and sync word, at
+//     least the sensitivity and the capture ratio above the noise plus the frames overlapping
+//     it (summed), then dropped with the loss probability of its link. The AES key must match
+//
+// Build the sketch library, then the host program (SessionBench, SessionSim), e.g.:
+//   S="sketch.cpp ../../RFM69_SessionKey.cpp ../../RFM69_SessionMac.cpp ../SessionHost/RFM69.cpp"
+//   g++ -O2 -std=gnu++11 -shared -fPIC -Wl,-Bsymbolic -I../SessionHost -I../.. -o sketch.so $S
+//   g++ -O2 -std=gnu++11 -rdynamic -I../SessionHost -o host host.cpp ../SessionHost/SessionHost.cpp -ldl
+// The sketch library takes the Arduino calls from the host program (-rdynamic), -Bsymbolic
+// keeps the static state of each copy to itself.
+// **********************************************************************************
+#ifndef SessionHost_h
+#define SessionHost_h
+#include <stdint.h>
+
+// AVR time of each call (ns), the rest of the code takes no time
+#define HOST_MILLIS_NS			1000		// millis()
+#define HOST_MICROS_NS			3500		// micros()
+#define HOST_PIN_NS				3500		// digitalRead(), digitalWrite(), pinMode()
+#define HOST_SPI_BYTE_NS		2500		// one byte at 4 MHz, with the loop around SPDR
+#define HOST_IRQ_NS				250			// noInterrupts(), interrupts()
+#define HOST_ISR_NS				3000		// interrupt entry and exit (attachInterrupt dispatch)
+#define HOST_LOOP_NS			1000		// one loop() call, Serial.available(), yield()
+#define HOST_RANDOM_NS			20000		// random()
+#define HOST_EEPROM_READ_NS		1000		// EEPROM.read()
+#define HOST_EEPROM_WRITE_NS	3300000		// EEPROM.write() of one byte
+// Radio timing (ns)
+#define HOST_TX_START_NS		120000		// from setMode(TX) to the first preamble bit on air
+#define HOST_RX_START_NS		100000		// from setMode(RX) to the receiver ready
+#define HOST_OSC_START_NS		250000		// from sleep to ModeReady (crystal start up)
+
+#define HOST_MAX_NODES			256
+#define HOST_EEPROM_SIZE		1024
+
+// Channel of the simulated world, set by hostBegin()
+struct HostChannel {
+  double noise;							// dBm, noise floor
+  double sensitivity;					// dBm, weakest frame received
+  double capture;						// dB, signal to (noise + interference) ratio a frame needs
+  double pathLoss;						// dB, path loss of the links not set by hostPathLoss()
+  uint32_t seed;						// losses and random() of the nodes
+};
+
+// Counters of the channel since hostBegin()
+struct HostChannelStats {
+  uint32_t frames;						// frames sent
+  uint32_t received;					// frames received (all receivers)
+  uint32_t collisions;					// frames lost by a receiver under the capture ratio
+  uint32_t losses;						// frames lost by the loss probability of the link
+};
+
+// Host program side
+void hostBegin(const HostChannel& channel);	// start an empty world at time 0
+int hostNode(const char* sketch);			// load a copy of a sketch library on a new node, -1 on error (printed)
+void hostPathLoss(int from, int to, double dB);	// path loss of one link
+void hostLinkLoss(int from, int to, double probability);	// frame loss probability of one link
+void hostInput(int node, const char* text);	// add text to the Serial input of a node
+void hostEcho(int node, bool echo);			// print the Serial output of a node on stdout
+void hostPower(int node, bool on);			// off: the node stops; on: fresh copy of the sketch library, setup() runs (EEPROM kept)
+bool hostIdle(int node);					// all its Serial input read and loop() returned since
+uint32_t hostIsrTime(int node);				// longest interrupt handler of a node (us), since it was powered on
+void hostRun(uint64_t until);				// run the nodes until the simulated time (us)
+uint64_t hostTime();						// simulated time (us) reached by hostRun()
+HostChannelStats hostChannelStats();
+void hostEnd();								// unload all the nodes
+
+// Sketch side
+int hostNodeIndex();						// node running the caller
+
+#endif
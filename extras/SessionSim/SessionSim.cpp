@@ -0,0 +1,458 @@
+// **********************************************************************************
+// RFM69_SessionKey network simulator
+// **********************************************************************************
+// Host simulation of one gateway and N nodes exchanging session frames over one shared
+// channel, to find out how a gateway scales with the number of nodes before going to the
+// field. Every node runs the real RFM69_SessionKey.cpp on the host backend
+// (extras/SessionHost): its own instance and static state, the simulated RFM69 (FIFO,
+// DIO0 interrupt, air time at the bitrate), Arduino calls timed as on an ATmega328:
+//   - nodes (SimNode.cpp): a report every --period s (or --burst of them, or all the
+//     nodes waking up together with --traffic reboot), each one sent to the gateway with
+//     sendWithRetry(), the radio and the CPU asleep between the wake ups
+//   - gateway (SimGateway.cpp): receiveDone(), --gwloop us of sketch, sendACK(); the CPU
+//     sleeps until the next interrupt between the frames
+//   - channel: nodes spread on a disc around the gateway, log-distance path loss with
+//     shadowing (the same both ways), capture ratio over the frames overlapping (summed),
+//     per-link loss, CSMA on the RSSI of the channel (hidden nodes happen when two nodes are
+//     too far apart to hear each other)
+//   - --restart: the gateway is off for --downtime s, it then runs setup() again, only its
+//     EEPROM is kept. Each node sends one report meanwhile, and one more within 50ms once it
+//     is back (worst case)
+//   - --resume: the frames carry a MAC, the nodes use the resume tickets of the gateway
+//     (useSessionResume), which gives --tickets of them and keeps them in its EEPROM
+//     (sessionResumeStore)
+// The library options are those of RFM69_SessionKey.h: build both sketch libraries with the
+// same -D options to change them (e.g. -DSESSION_PEER_TABLE_SIZE=16 -DSESSION_REPLY_QUEUE_SIZE=8,
+// powers of 2).
+// CSMA_LIMIT is the one of extras/SessionHost/RFM69.h (-90 dBm).
+//
+// Build and run on the host (Linux), from this directory:
+//   S="../../RFM69_SessionKey.cpp ../../RFM69_SessionMac.cpp ../SessionHost/RFM69.cpp"
+//   g++ -O2 -std=gnu++11 -shared -fPIC -Wl,-Bsymbolic -I../SessionHost -I../.. -o sim-gateway.so SimGateway.cpp $S
+//   g++ -O2 -std=gnu++11 -shared -fPIC -Wl,-Bsymbolic -I../SessionHost -I../.. -o sim-node.so SimNode.cpp $S
+//   g++ -O2 -std=gnu++11 -rdynamic -I../SessionHost -o session-sim SessionSim.cpp ../SessionHost/SessionHost.cpp -ldl
+//   ./session-sim --nodes 10,25,50 --traffic periodic --period 60 --duration 600
+// ./session-sim --help lists the options, a wrong one exits with code 1. One line is printed
+// per node count:
+//   delivery   reports acknowledged by the gateway within the retries
+//   handshake  session keys received per key request sent (sessionStats of the nodes)
+//   mismatch   frames refused by the gateway with an unexpected key (its keyMismatches)
+//   collisions frames lost under the capture ratio, counted by every receiver (also the frames to other nodes)
+//   p50..max   latency (ms) from the report generation to its ACK
+//   ack(ms)    time the gateway spends in sendACK() per frame acknowledged (ACK copies and delays)
+//   settle(s)  with --restart: time from the gateway back until each node had a report acknowledged
+//              (the nodes without report acknowledged before the restart are not counted)
+// The simulated time runs about 10 times faster than real time while the channel is busy.
+// **********************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "SessionHost.h"
+#include "SessionSim.h"
+
+#define GATEWAY				0				// host node index of the gateway
+#define NOISE_DBM			-100.0			// channel noise floor
+#define DRAIN_S				30				// s after the report generation for the last ones to be sent
+#define MAX_COUNTS			16				// node counts of --nodes
+
+struct Options {
+  std::vector<int> nodes;
+  double period;				// s between two reports of a node
+  double duration;				// s of report generation
+  double radius;				// m, nodes are spread uniformly on a disc around the gateway
+  double txPower;				// dBm
+  double pathLoss;				// dB at 1m
+  double exponent;				// path loss exponent
+  double shadowing;				// dB, standard deviation
+  double sensitivity;			// dBm
+  double capture;				// dB a frame must be above the noise and the frames overlapping it
+  double loss;					// frame loss probability on top of the collisions
+  double bitrate;				// bps
+  double restart;				// s at which the gateway restarts, 0 for none
+  double downtime;				// s the gateway is off
+  long seed;
+  const char* gateway;			// sketch libraries
+  const char* node;
+};
+
+// What the sketches report, per host node index
+struct NodeResult {
+  uint8_t pending;
+  uint32_t handshakesStarted, handshakesCompleted, keyMismatches, framesAccepted;
+  bool reached;					// a report was acknowledged before the restart
+  uint64_t settled;				// us, first report acknowledged after the restart (0: none)
+};
+
+struct Result {
+  uint32_t offered, delivered;
+  uint32_t acks;				// sendACK() calls
+  uint64_t ackTime;				// us spent in sendACK()
+  std::vector<uint32_t> latency;	// us
+  uint32_t collisions;			// hostChannelStats()
+  std::vector<NodeResult> nodes;
+  NodeResult gatewayBefore;		// counters of the gateway before its restart
+};
+
+static Options opt;
+static SimConfig sim;
+static Result result;
+static uint64_t restartTime, gatewayOnTime;		// us
+
+//=============================================================================
+// Sketch side (SessionSim.h), called by the nodes running
+//=============================================================================
+const SimConfig* simConfig()
+{
+  return &sim;
+}
+
+void simOffered()
+{
+  result.offered++;
+}
+
+void simPending(uint8_t count)
+{
+  result.nodes[hostNodeIndex()].pending = count;
+}
+
+void simDelivered(unsigned long generated, unsigned long acked)
+{
+  NodeResult& node = result.nodes[hostNodeIndex()];
+  result.delivered++;
+  result.latency.push_back(acked - generated);
+  if (opt.restart > 0)
+  {
+    if (acked < restartTime) node.reached = true;
+    else if (acked >= gatewayOnTime && gatewayOnTime > 0 && node.settled == 0) node.settled = acked;
+  }
+}
+
+void simAck(unsigned long us)
+{
+  result.acks++;
+  result.ackTime += us;
+}
+
+void simStats(uint32_t handshakesStarted, uint32_t handshakesCompleted, uint32_t keyMismatches, uint32_t framesAccepted)
+{
+  NodeResult& node = result.nodes[hostNodeIndex()];
+  node.handshakesStarted = handshakesStarted;
+  node.handshakesCompleted = handshakesCompleted;
+  node.keyMismatches = keyMismatches;
+  node.framesAccepted = framesAccepted;
+}
+
+//=============================================================================
+// Simulation of one node count
+//=============================================================================
+static void setInput(int count, const char* text)
+{
+  for (int i = 1; i <= count; i++) hostInput(i, text);
+}
+
+static bool simulate(int count, uint32_t seed)
+{
+  result.offered = result.delivered = result.acks = 0;
+  result.ackTime = 0;
+  result.latency.clear();
+  NodeResult none = {};
+  result.nodes.assign(count + 1, none);
+  result.gatewayBefore = none;
+  restartTime = opt.restart > 0 ? (uint64_t)(opt.restart * 1e6) : 0;
+  gatewayOnTime = 0;
+
+  HostChannel channel = { NOISE_DBM, opt.sensitivity, opt.capture, 0, seed };
+  hostBegin(channel);
+  if (hostNode(opt.gateway) != GATEWAY) return false;
+  for (int i = 1; i <= count; i++)
+    if (hostNode(opt.node) != i) return false;
+  // gateway in the middle, path loss the same both ways, shadowing included
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::normal_distribution<double> shadow(0, opt.shadowing);
+  std::vector<double> x(count + 1, 0), y(count + 1, 0);
+  for (int i = 1; i <= count; i++)
+  {
+    double r = opt.radius * sqrt(uniform(rng));
+    double a = 6.283185307179586 * uniform(rng);
+    x[i] = r * cos(a);
+    y[i] = r * sin(a);
+  }
+  for (int i = 0; i <= count; i++)
+    for (int j = i + 1; j <= count; j++)
+    {
+      double d = hypot(x[i] - x[j], y[i] - y[j]);
+      double loss = opt.pathLoss + 10 * opt.exponent * log10(d < 1 ? 1 : d) - shadow(rng);
+      hostPathLoss(i, j, loss);
+      hostPathLoss(j, i, loss);
+      hostLinkLoss(i, j, opt.loss);
+      hostLinkLoss(j, i, opt.loss);
+    }
+
+  if (restartTime > 0)
+  {
+    hostRun(restartTime);
+    result.gatewayBefore = result.nodes[GATEWAY];
+    result.nodes[GATEWAY] = none;
+    hostPower(GATEWAY, false);
+    setInput(count, "r");
+    hostRun(restartTime + (uint64_t)(opt.downtime * 1e6));
+    gatewayOnTime = hostTime();
+    hostPower(GATEWAY, true);
+    setInput(count, "R");
+  }
+  hostRun((uint64_t)((opt.duration + DRAIN_S) * 1e6));
+  result.collisions = hostChannelStats().collisions;
+  hostEnd();
+  return true;
+}
+
+//=============================================================================
+// Command line
+//=============================================================================
+static void usage()
+{
+  printf("usage: session-sim [options]\n"
+    "  --nodes 10,25,50,100,250  node counts simulated (1 to 254 each)\n"
+    "  --traffic periodic        periodic, burst (--burst reports per wake up) or reboot (all nodes start together)\n"
+    "  --period 60               s between two wake ups of a node\n"
+    "  --burst 5                 reports per wake up with --traffic burst\n"
+    "  --duration 3600           s of report generation\n"
+    "  --payload 20              data bytes per report (up to 53)\n"
+    "  --wait 40                 sessionWaitTime (ms)\n"
+    "  --retries 2               sendWithRetry retries\n"
+    "  --3acks                   3 ACKs per frame (useSession3Acks)\n"
+    "  --gwloop 1000             us from receiveDone() to sendACK() in the gateway sketch\n"
+    "  --backoff 4               sessionBackoff slot (ms), 0 to send as soon as the channel is free\n"
+    "  --backoffmax 5            sessionBackoff maxExponent\n"
+    "  --radius 150              m, radius of the disc the nodes are spread on\n"
+    "  --txpower 13              dBm (-18 to 13, RFM69W)\n"
+    "  --exponent 3              path loss exponent (40 dB at 1m)\n"
+    "  --shadowing 4             dB\n"
+    "  --sensitivity -95         dBm\n"
+    "  --capture 6               dB\n"
+    "  --loss 0.01               frame loss probability on top of the collisions\n"
+    "  --bitrate 55555           bps\n"
+    "  --restart 0               s at which the gateway restarts, 0 for none\n"
+    "  --downtime 2              s the gateway is off at restart\n"
+    "  --resume                  resume tickets (useSessionResume, sessionResumeStore), frames with a MAC\n"
+    "  --tickets 16              resume tickets of the gateway (1 to 32)\n"
+    "  --seed 1\n"
+    "  --gateway ./sim-gateway.so  sketch library of the gateway\n"
+    "  --node ./sim-node.so      sketch library of the nodes\n");
+}
+
+static bool parseLong(const char* name, const char* v, long low, long high, long* value)
+{
+  char* end;
+  errno = 0;
+  long x = strtol(v, &end, 10);
+  if (*v == 0 || *end != 0 || errno != 0 || x < low || x > high)
+  {
+    fprintf(stderr, "session-sim: %s must be an integer from %ld to %ld, not '%s'\n", name, low, high, v);
+    return false;
+  }
+  *value = x;
+  return true;
+}
+
+static bool parseDouble(const char* name, const char* v, double low, double high, double* value)
+{
+  char* end;
+  errno = 0;
+  double x = strtod(v, &end);
+  if (*v == 0 || *end != 0 || errno != 0 || !(x >= low && x <= high))
+  {
+    fprintf(stderr, "session-sim: %s must be a number from %g to %g, not '%s'\n", name, low, high, v);
+    return false;
+  }
+  *value = x;
+  return true;
+}
+
+static bool parseNodes(const char* v)
+{
+  opt.nodes.clear();
+  const char* p = v;
+  for (;;)
+  {
+    const char* comma = strchr(p, ',');
+    char item[16];
+    size_t length = comma ? (size_t)(comma - p) : strlen(p);
+    long count;
+    if (length >= sizeof(item) || opt.nodes.size() >= MAX_COUNTS)
+    {
+      fprintf(stderr, "session-sim: --nodes must be up to %d node counts, not '%s'\n", MAX_COUNTS, v);
+      return false;
+    }
+    memcpy(item, p, length);
+    item[length] = 0;
+    if (!parseLong("--nodes", item, 1, SIM_MAX_NODES, &count)) return false;
+    opt.nodes.push_back(count);
+    if (!comma) return true;
+    p = comma + 1;
+  }
+}
+
+static bool parse(int argc, char** argv)
+{
+  opt.period = 60;
+  opt.duration = 3600;
+  opt.radius = 150;
+  opt.txPower = 13;
+  opt.pathLoss = 40;
+  opt.exponent = 3;
+  opt.shadowing = 4;
+  opt.sensitivity = -95;
+  opt.capture = 6;
+  opt.loss = 0.01;
+  opt.bitrate = 55555;
+  opt.restart = 0;
+  opt.downtime = 2;
+  opt.seed = 1;
+  opt.gateway = "./sim-gateway.so";
+  opt.node = "./sim-node.so";
+  long burst = 5, payload = 20, waitTime = 40, retries = 2, gwLoop = 1000, backoffSlot = 4, backoffMax = 5, tickets = 16;
+  sim.traffic = SIM_PERIODIC;
+  sim.acks3 = false;
+  sim.resume = false;
+  if (!parseNodes("10,25,50,100,250")) return false;
+  for (int i = 1; i < argc; i++)
+  {
+    const char* o = argv[i];
+    if (!strcmp(o, "--help")) return false;
+    if (!strcmp(o, "--3acks")) { sim.acks3 = true; continue; }
+    if (!strcmp(o, "--resume")) { sim.resume = true; continue; }
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "session-sim: %s needs a value\n", o);
+      return false;
+    }
+    const char* v = argv[++i];
+    bool ok = true;
+    if (!strcmp(o, "--nodes")) ok = parseNodes(v);
+    else if (!strcmp(o, "--traffic"))
+    {
+      if (!strcmp(v, "periodic")) sim.traffic = SIM_PERIODIC;
+      else if (!strcmp(v, "burst")) sim.traffic = SIM_BURST;
+      else if (!strcmp(v, "reboot")) sim.traffic = SIM_REBOOT;
+      else
+      {
+        fprintf(stderr, "session-sim: --traffic must be periodic, burst or reboot, not '%s'\n", v);
+        ok = false;
+      }
+    }
+    else if (!strcmp(o, "--period")) ok = parseDouble(o, v, 0.01, 86400, &opt.period);
+    else if (!strcmp(o, "--burst")) ok = parseLong(o, v, 1, SIM_MAX_PENDING, &burst);
+    else if (!strcmp(o, "--duration")) ok = parseDouble(o, v, 0.001, 4000000, &opt.duration);
+    else if (!strcmp(o, "--payload")) ok = parseLong(o, v, 0, SIM_MAX_DATA_LEN, &payload);
+    else if (!strcmp(o, "--wait")) ok = parseLong(o, v, 1, 255, &waitTime);
+    else if (!strcmp(o, "--retries")) ok = parseLong(o, v, 0, 20, &retries);
+    else if (!strcmp(o, "--gwloop")) ok = parseLong(o, v, 0, 65535, &gwLoop);
+    else if (!strcmp(o, "--backoff")) ok = parseLong(o, v, 0, 255, &backoffSlot);
+    else if (!strcmp(o, "--backoffmax")) ok = parseLong(o, v, 0, 8, &backoffMax);
+    else if (!strcmp(o, "--radius")) ok = parseDouble(o, v, 0, 100000, &opt.radius);
+    else if (!strcmp(o, "--txpower")) ok = parseDouble(o, v, -18, 13, &opt.txPower);
+    else if (!strcmp(o, "--exponent")) ok = parseDouble(o, v, 1, 10, &opt.exponent);
+    else if (!strcmp(o, "--shadowing")) ok = parseDouble(o, v, 0, 50, &opt.shadowing);
+    else if (!strcmp(o, "--sensitivity")) ok = parseDouble(o, v, -150, 0, &opt.sensitivity);
+    else if (!strcmp(o, "--capture")) ok = parseDouble(o, v, -20, 50, &opt.capture);
+    else if (!strcmp(o, "--loss")) ok = parseDouble(o, v, 0, 1, &opt.loss);
+    else if (!strcmp(o, "--bitrate")) ok = parseDouble(o, v, 1200, 300000, &opt.bitrate);
+    else if (!strcmp(o, "--restart")) ok = parseDouble(o, v, 0, 4000000, &opt.restart);
+    else if (!strcmp(o, "--downtime")) ok = parseDouble(o, v, 0.001, 86400, &opt.downtime);
+    else if (!strcmp(o, "--tickets")) ok = parseLong(o, v, 1, SIM_MAX_TICKETS, &tickets);
+    else if (!strcmp(o, "--seed")) ok = parseLong(o, v, 0, 0x7FFFFFFF, &opt.seed);
+    else if (!strcmp(o, "--gateway")) opt.gateway = v;
+    else if (!strcmp(o, "--node")) opt.node = v;
+    else
+    {
+      fprintf(stderr, "session-sim: unknown option %s\n", o);
+      ok = false;
+    }
+    if (!ok) return false;
+  }
+  if (opt.restart > 0 && opt.restart >= opt.duration)
+  {
+    fprintf(stderr, "session-sim: --restart must be within --duration\n");
+    return false;
+  }
+  sim.period = (uint32_t)(opt.period * 1000);
+  sim.burst = burst;
+  sim.duration = (uint32_t)(opt.duration * 1000);
+  sim.payload = payload;
+  sim.waitTime = waitTime;
+  sim.retries = retries;
+  sim.gwLoop = gwLoop;
+  sim.backoffSlot = backoffSlot;
+  sim.backoffMax = backoffMax;
+  sim.powerLevel = (uint8_t)lround(opt.txPower + 18);
+  sim.bitrate = (uint16_t)lround(32e6 / opt.bitrate);
+  sim.downtime = (uint32_t)(opt.downtime * 1000);
+  sim.tickets = tickets;
+  return true;
+}
+
+static double percentile(const std::vector<uint32_t>& sorted, int pct)
+{
+  if (sorted.empty()) return 0;
+  size_t index = (sorted.size() * pct + 99) / 100;	// nearest-rank method
+  return sorted[index ? index - 1 : 0] / 1000.0;
+}
+
+int main(int argc, char** argv)
+{
+  if (!parse(argc, argv))
+  {
+    usage();
+    return 1;
+  }
+  printf("nodes  offered  delivery  handshake  mismatch  collisions   p50(ms)  p90(ms)  p99(ms)  max(ms)  ack(ms)  settle(s)\n");
+  for (size_t i = 0; i < opt.nodes.size(); i++)
+  {
+    int count = opt.nodes[i];
+    if (!simulate(count, opt.seed + i))
+    {
+      hostEnd();
+      return 2;
+    }
+    Result& r = result;
+    std::sort(r.latency.begin(), r.latency.end());
+    // reports left in a node queue when the simulation stopped are not counted
+    uint32_t offered = r.offered;
+    uint32_t started = 0, completed = 0;
+    double settle = 0;
+    for (int n = 1; n <= count; n++)
+    {
+      const NodeResult& node = r.nodes[n];
+      offered -= node.pending;
+      started += node.handshakesStarted;
+      completed += node.handshakesCompleted;
+      if (opt.restart <= 0 || !node.reached) continue;	// out of range of the gateway
+      if (node.settled == 0) settle = -1;
+      else if (settle >= 0) settle = std::max(settle, (node.settled - gatewayOnTime) / 1e6);
+    }
+    uint32_t mismatches = r.gatewayBefore.keyMismatches + r.nodes[GATEWAY].keyMismatches;
+    uint32_t received = mismatches + r.gatewayBefore.framesAccepted + r.nodes[GATEWAY].framesAccepted;
+    char settled[16] = "-";
+    if (opt.restart > 0 && settle >= 0) snprintf(settled, sizeof(settled), "%.2f", settle);
+    printf("%5d  %7u  %7.2f%%  %8.2f%%  %7.2f%%  %10u  %8.1f %8.1f %8.1f %8.1f %8.1f  %9s\n",
+      count, offered,
+      offered ? 100.0 * r.delivered / offered : 0,
+      started ? 100.0 * completed / started : 0,
+      received ? 100.0 * mismatches / received : 0,
+      r.collisions,
+      percentile(r.latency, 50), percentile(r.latency, 90), percentile(r.latency, 99),
+      r.latency.empty() ? 0 : r.latency.back() / 1000.0,
+      r.acks ? r.ackTime / 1000.0 / r.acks : 0, settled);
+    fflush(stdout);
+  }
+  return 0;
+}
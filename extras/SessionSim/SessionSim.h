@@ -0,0 +1,50 @@
+// **********************************************************************************
+// RFM69_SessionKey network simulator: simulator and sketches interface
+// **********************************************************************************
+// The gateway (SimGateway.cpp) and node (SimNode.cpp) sketches read the options of the run
+// and report what they see to the simulator (SessionSim.cpp). These functions are defined
+// by the simulator program, the sketch libraries take them from it when they are loaded.
+// **********************************************************************************
+#ifndef SessionSim_h
+#define SessionSim_h
+#include <stdint.h>
+
+#define SIM_GATEWAY_ID		0				// node IDs: the gateway, then 1 to 254 (host node index)
+#define SIM_MAX_NODES		254				// 255 is the broadcast address
+#define SIM_MAX_TICKETS		32				// SESSION_RESUME_MAX_TICKETS
+#define SIM_MAX_PENDING		8				// reports a node keeps while busy, the next ones are dropped
+#define SIM_MAX_DATA_LEN	53				// SESSION_MAX_DATA_LEN (room left for the MAC)
+
+enum SimTraffic { SIM_PERIODIC, SIM_BURST, SIM_REBOOT };
+
+// Options of the run, the same for all the nodes
+struct SimConfig {
+  SimTraffic traffic;
+  uint32_t period;					// ms between two wake ups of a node
+  uint8_t burst;					// reports per wake up with SIM_BURST
+  uint32_t duration;				// ms of report generation
+  uint8_t payload;					// data bytes per report
+  uint16_t waitTime;				// sessionWaitTime() (ms)
+  uint8_t retries;					// sendWithRetry() retries
+  bool acks3;						// useSession3Acks()
+  uint16_t gwLoop;					// us from receiveDone() to sendACK() in the gateway sketch
+  uint8_t backoffSlot;				// sessionBackoff() slot (ms), 0 without backoff
+  uint8_t backoffMax;				// sessionBackoff() maxExponent
+  uint8_t powerLevel;				// setPowerLevel() (RFM69W: -18 dBm + level)
+  uint16_t bitrate;					// RegBitrate value (32 MHz / bps)
+  uint32_t downtime;				// ms the gateway is off at restart
+  bool resume;						// useSessionResume(), sessionResumeStore(), frames with a MAC
+  uint8_t tickets;					// resume tickets of the gateway
+};
+
+const SimConfig* simConfig();
+// Node side
+void simOffered();											// a report was generated
+void simPending(uint8_t count);								// reports waiting in the node
+void simDelivered(unsigned long generated, unsigned long acked);	// micros() of a report and of its ACK
+// Gateway side
+void simAck(unsigned long us);								// time spent in sendACK()
+// Both: sessionStats() counters of the calling node
+void simStats(uint32_t handshakesStarted, uint32_t handshakesCompleted, uint32_t keyMismatches, uint32_t framesAccepted);
+
+#endif
@@ -0,0 +1,89 @@
+// **********************************************************************************
+// RFM69_SessionKey network simulator: gateway sketch
+// **********************************************************************************
+// Gateway of the simulated network (SessionSim.cpp): receiveDone(), the sketch handling
+// the frame for --gwloop us, then sendACK(). The CPU sleeps until the next interrupt
+// between the frames. With --resume it gives the resume tickets, saved in its EEPROM
+// by sessionResumeFlush() when no frame is waiting, the EEPROM is kept when the
+// simulator restarts it.
+// Built into a sketch library of the host backend (extras/SessionHost), see SessionSim.cpp.
+// **********************************************************************************
+#include <RFM69_SessionKey.h>
+#include <RFM69.h>
+#include <RFM69registers.h>
+#include <SPI.h>
+#include <EEPROM.h>
+#include "SessionSim.h"
+
+#if !SESSION_USE_STATS
+#error "SessionSim reads the key mismatches from sessionStats(), build with SESSION_USE_STATS"
+#endif
+
+#define NETWORKID     110
+#define FREQUENCY     RF69_433MHZ
+#define ENCRYPTKEY    "sampleEncryptKey"
+#define MACKEY        "sampleMacKey0123"
+#define RESUME_ADDR   16   // EEPROM area of the resume tickets, as Examples/RFM69-gw-session
+#define RESUME_SIZE   512
+
+RFM69_SessionKey radio;
+#if SESSION_USE_RESUME
+#if SESSION_RESUME_MAX_TICKETS < SIM_MAX_TICKETS
+#error "SIM_MAX_TICKETS is above SESSION_RESUME_MAX_TICKETS"
+#endif
+SessionResume tickets[SIM_MAX_TICKETS];
+
+void storeRead(uint16_t address, uint8_t* data, uint8_t length)
+{
+  for (uint8_t i = 0; i < length; i++) data[i] = EEPROM.read(address + i);
+}
+
+void storeWrite(uint16_t address, const uint8_t* data, uint8_t length)
+{
+  for (uint8_t i = 0; i < length; i++) EEPROM.update(address + i, data[i]);
+}
+#endif
+
+void setup()
+{
+  const SimConfig* sim = simConfig();
+  radio.initialize(FREQUENCY, SIM_GATEWAY_ID, NETWORKID);
+  radio.writeReg(REG_BITRATEMSB, sim->bitrate >> 8);
+  radio.writeReg(REG_BITRATELSB, sim->bitrate);
+  radio.setPowerLevel(sim->powerLevel);
+  radio.encrypt(ENCRYPTKEY);
+  radio.useSessionKey(true);
+  radio.sessionWaitTime(sim->waitTime);
+  radio.useSession3Acks(sim->acks3);
+  radio.sessionBackoff(sim->backoffSlot, sim->backoffMax);
+#if SESSION_USE_RESUME
+  if (sim->resume)
+  {
+    radio.useSessionMac(MACKEY);
+    radio.sessionResumeStore(tickets, sim->tickets, storeRead, storeWrite, RESUME_ADDR, RESUME_SIZE);
+  }
+#endif
+}
+
+void loop()
+{
+  const SimConfig* sim = simConfig();
+  if (!radio.receiveDone())
+  {
+#if SESSION_USE_RESUME
+    radio.sessionResumeFlush();         // between two frames, as Examples/RFM69-gw-session
+#endif
+    hostSleep(1000);                    // until the next frame
+    return;
+  }
+  if (radio.ACKRequested())
+  {
+    delayMicroseconds(sim->gwLoop);     // the sketch handles the frame
+    unsigned long start = micros();
+    radio.sendACK();
+    simAck(micros() - start);
+  }
+  SessionStats stats;
+  radio.sessionStats(&stats);
+  simStats(stats.handshakesStarted, stats.handshakesCompleted, stats.keyMismatches, stats.framesAccepted);
+}
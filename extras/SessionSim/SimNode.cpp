@@ -0,0 +1,117 @@
+// **********************************************************************************
+// RFM69_SessionKey network simulator: node sketch
+// **********************************************************************************
+// Battery node of the simulated network (SessionSim.cpp): wakes up every period (all the
+// nodes together with --traffic reboot), generates its reports and sends each one to the
+// gateway with sendWithRetry(), then puts the radio and the CPU to sleep until the next
+// wake up. A 'r' on Serial (the gateway went off) adds one report within half the downtime,
+// a 'R' (the gateway is back) one more within 50ms.
+// Built into a sketch library of the host backend (extras/SessionHost), see SessionSim.cpp.
+// **********************************************************************************
+#include <RFM69_SessionKey.h>
+#include <RFM69.h>
+#include <RFM69registers.h>
+#include <SPI.h>
+#include <SessionHost.h>
+#include "SessionSim.h"
+
+#if !SESSION_USE_STATS
+#error "SessionSim reads the handshakes from sessionStats(), build with SESSION_USE_STATS"
+#endif
+
+#define NETWORKID     110
+#define FREQUENCY     RF69_433MHZ
+#define ENCRYPTKEY    "sampleEncryptKey"
+#define MACKEY        "sampleMacKey0123"
+#define EXTRA_REPORTS 2    // 'r' and 'R'
+
+RFM69_SessionKey radio;
+uint8_t payload[SESSION_MAX_DATA_LEN];
+unsigned long pending[SIM_MAX_PENDING]; // micros() the waiting reports were generated
+uint8_t pendingCount = 0;
+unsigned long nextWake;                 // millis() of the next periodic wake up
+unsigned long extraWake[EXTRA_REPORTS];
+uint8_t extraCount = 0;
+
+void setup()
+{
+  const SimConfig* sim = simConfig();
+  radio.initialize(FREQUENCY, hostNodeIndex(), NETWORKID);
+  radio.writeReg(REG_BITRATEMSB, sim->bitrate >> 8);
+  radio.writeReg(REG_BITRATELSB, sim->bitrate);
+  radio.setPowerLevel(sim->powerLevel);
+  radio.encrypt(ENCRYPTKEY);
+  radio.useSessionKey(true);
+  radio.sessionWaitTime(sim->waitTime);
+  radio.useSession3Acks(sim->acks3);
+  radio.sessionBackoff(sim->backoffSlot, sim->backoffMax);
+#if SESSION_USE_RESUME
+  if (sim->resume)
+  {
+    radio.useSessionMac(MACKEY);
+    radio.useSessionResume(true);
+  }
+#endif
+  for (uint8_t i = 0; i < sizeof(payload); i++)
+    payload[i] = 'A' + (i % 26);
+  // first wake up: random phase, or all the nodes within 50ms of a common power up
+  nextWake = sim->traffic == SIM_REBOOT ? random(50) : random(sim->period);
+  radio.sleep();
+}
+
+void generate(uint8_t count)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    simOffered();
+    if (pendingCount < SIM_MAX_PENDING) pending[pendingCount++] = micros();
+  }
+  simPending(pendingCount);
+}
+
+void loop()
+{
+  const SimConfig* sim = simConfig();
+  unsigned long now = millis();
+  while (Serial.available() > 0)
+  {
+    char input = Serial.read();
+    if (extraCount < EXTRA_REPORTS && (input == 'r' || input == 'R'))
+      extraWake[extraCount++] = now + (input == 'r' ? random(sim->downtime / 2 + 1) : random(50));
+  }
+  if (now < sim->duration)
+  {
+    if ((long)(now - nextWake) >= 0)
+    {
+      generate(sim->traffic == SIM_BURST ? sim->burst : 1);
+      nextWake += sim->period - sim->period / 1000 + random(sim->period / 500 + 1); // +-0.1% clock drift
+    }
+    for (uint8_t i = 0; i < extraCount; )
+    {
+      if ((long)(now - extraWake[i]) < 0) i++;
+      else
+      {
+        generate(1);
+        extraWake[i] = extraWake[--extraCount];
+      }
+    }
+  }
+
+  if (pendingCount > 0)
+  {
+    if (radio.sendWithRetry(SIM_GATEWAY_ID, payload, sim->payload, sim->retries, sim->waitTime))
+      simDelivered(pending[0], micros());
+    for (uint8_t i = 1; i < pendingCount; i++) pending[i - 1] = pending[i];
+    simPending(--pendingCount);
+    SessionStats stats;
+    radio.sessionStats(&stats);
+    simStats(stats.handshakesStarted, stats.handshakesCompleted, stats.keyMismatches, stats.framesAccepted);
+    return;
+  }
+  // nothing to send: radio and CPU asleep until the next report
+  unsigned long wake = now < sim->duration ? nextWake : now + sim->period;
+  for (uint8_t i = 0; i < extraCount; i++)
+    if ((long)(extraWake[i] - wake) < 0) wake = extraWake[i];
+  radio.sleep();
+  if ((long)(wake - now) > 0) hostSleep(wake - now);
+}
@@ -0,0 +1,254 @@
+// **********************************************************************************
+// RFM69_SessionKey trace decoder
+// **********************************************************************************
+// Host decoder of the trace ring dumped by sessionTraceDump() (SESSION_USE_TRACE): the
+// frames sent and received and the timeouts of one node, recorded without any Serial
+// output in the send and receive paths, so the timing is not changed by the trace.
+//
+// The capture is any file holding one or more dumps, e.g. the serial output of a sketch
+// writing the dump with Serial.write() between its text lines: each dump is found by its
+// 'S' 'T' SESSION_TRACE_FORMAT header. Dumps of several nodes can be in the same capture.
+//
+// Build and run on the host, neither Arduino nor the RFM69 library is needed:
+//   g++ -O2 -std=c++11 -o session-trace SessionTrace.cpp
+//   ./session-trace capture.bin
+//   ./session-trace --pcap trace.pcap capture.bin
+// One line is printed per event:
+//   time(ms)   since the first event of the dump (micros() of the node, wraps unfolded)
+//   delta(ms)  since the previous event
+//   event      TX (frame loaded in the FIFO), RX (frame received) or TIMEOUT
+//   peer       node the frame is sent to or received from
+//   ctl        flags of the CTL byte: ACK, REQACK, KEYREQ, KEY (RFM69 bits), STREAM,
+//              GROUP, RECORDS, MAC (RFM69_SessionKey bits)
+//   key        session key of the frame
+//   status     TX: payload bytes; RX: plain, accepted, refused, reply (answered by
+//              sessionService), key (key response), resync; TIMEOUT: key or ack wait
+// followed by the handshake latency of the dump: key request sent to key response received.
+// --pcap also writes the events to a pcap file (link type USER0, one 13 byte packet per
+// event: node ID then the entry as dumped), to line them up with other captures.
+// **********************************************************************************
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define TRACE_FORMAT		1				// SESSION_TRACE_FORMAT
+#define TRACE_HEADER		11				// SESSION_TRACE_HEADER
+#define TRACE_ENTRY			12				// SESSION_TRACE_ENTRY
+#define TRACE_TX			1				// SESSION_TRACE_TX
+#define TRACE_RX			2				// SESSION_TRACE_RX
+#define TRACE_TIMEOUT		3				// SESSION_TRACE_TIMEOUT
+#define TRACE_KEY			5				// SESSION_TRACE_KEY
+#define SEND_KEY_WAIT		3				// SESSION_SEND_KEY_WAIT
+#define SEND_ACK_WAIT		5				// SESSION_SEND_ACK_WAIT
+#define CTL_REQUEST			0x20			// RFM69_CTL_EXT1
+#define CTL_INCLUDED		0x10			// RFM69_CTL_EXT2
+#define LINKTYPE_USER0		147
+
+struct Entry {
+  uint64_t time;					// us, wraps of micros() unfolded
+  uint8_t event, ctl, peer, status;
+  uint32_t key;
+  const uint8_t* raw;				// entry as dumped
+};
+
+static FILE* pcap = NULL;
+
+static uint32_t get32(const uint8_t* p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put32(uint8_t* p, uint32_t value)		// pcap files are written little endian
+{
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+//=============================================================================
+// ctlFlags(), statusText() - Names of the CTL bits and of the status of an event
+//=============================================================================
+static const char* ctlFlags(uint8_t ctl, char* text)
+{
+  static const char* names[8] = { "MAC", "RECORDS", "GROUP", "STREAM", "KEY", "KEYREQ", "REQACK", "ACK" };
+  text[0] = 0;
+  for (int bit = 7; bit >= 0; bit--)
+    if (ctl & (1 << bit))
+    {
+      if (text[0]) strcat(text, " ");
+      strcat(text, names[bit]);
+    }
+  if (!text[0]) strcpy(text, "-");
+  return text;
+}
+
+static const char* statusText(const Entry& e, char* text)
+{
+  static const char* rx[7] = { "?", "plain", "accepted", "refused", "reply", "key", "resync" };
+  if (e.event == TRACE_TX) sprintf(text, "%u bytes", e.status);
+  else if (e.event == TRACE_RX) strcpy(text, e.status < 7 ? rx[e.status] : "?");
+  else if (e.event == TRACE_TIMEOUT) strcpy(text, e.status == SEND_KEY_WAIT ? "key wait" : e.status == SEND_ACK_WAIT ? "ack wait" : "?");
+  else strcpy(text, "?");
+  return text;
+}
+
+//=============================================================================
+// writePcap() - One packet per event: node ID, then the entry as dumped
+//=============================================================================
+static void writePcapHeader()
+{
+  uint8_t header[24];
+  put32(header, 0xA1B2C3D4);
+  header[4] = 2; header[5] = 0;			// version 2.4
+  header[6] = 4; header[7] = 0;
+  put32(header + 8, 0);					// GMT offset
+  put32(header + 12, 0);				// timestamp accuracy
+  put32(header + 16, 65535);			// snapshot length
+  put32(header + 20, LINKTYPE_USER0);
+  fwrite(header, 1, sizeof(header), pcap);
+}
+
+static void writePcap(uint8_t node, const Entry& e)
+{
+  uint8_t record[16 + 1 + TRACE_ENTRY];
+  put32(record, (uint32_t)(e.time / 1000000));
+  put32(record + 4, (uint32_t)(e.time % 1000000));
+  put32(record + 8, 1 + TRACE_ENTRY);
+  put32(record + 12, 1 + TRACE_ENTRY);
+  record[16] = node;
+  memcpy(record + 17, e.raw, TRACE_ENTRY);
+  fwrite(record, 1, sizeof(record), pcap);
+}
+
+//=============================================================================
+// decode() - Print the timeline of one dump, return its length (0 if it is cut short)
+//=============================================================================
+static size_t decode(const uint8_t* dump, size_t size)
+{
+  if (size < TRACE_HEADER) return 0;
+  uint8_t node = dump[3];
+  uint16_t recorded = (uint16_t)dump[4] << 8 | dump[5];
+  uint32_t now = get32(dump + 6);
+  uint8_t count = dump[10];
+  size_t length = TRACE_HEADER + (size_t)count * TRACE_ENTRY;
+  if (size < length) return 0;
+  // the entries are in order: a time below the previous one is a wrap of micros()
+  std::vector<Entry> entries(count);
+  uint64_t base = 0;
+  for (int i = 0; i < count; i++)
+  {
+    const uint8_t* p = dump + TRACE_HEADER + i * TRACE_ENTRY;
+    uint32_t time = get32(p);
+    if (i > 0 && time < (uint32_t)entries[i - 1].time) base += 1ULL << 32;
+    Entry e = { base + time, p[4], p[5], p[6], p[7], get32(p + 8), p };
+    entries[i] = e;
+  }
+  printf("node %u: %u events recorded, %u in the dump", node, recorded, count);
+  if (recorded > count) printf(" (%u overwritten)", recorded - count);
+  if (count > 0) printf(", dumped %.3f ms after the last one", (uint32_t)(now - (uint32_t)entries[count - 1].time) / 1000.0);
+  printf("\n");
+  if (count == 0) return length;
+  printf("   time(ms)  delta(ms)  event    peer  ctl                        key       status\n");
+  char flags[64], status[16];
+  std::vector<double> handshakes;
+  for (int i = 0; i < count; i++)
+  {
+    const Entry& e = entries[i];
+    const char* event = e.event == TRACE_TX ? "TX" : e.event == TRACE_RX ? "RX" : e.event == TRACE_TIMEOUT ? "TIMEOUT" : "?";
+    printf("%11.3f %10.3f  %-7s  %4u  %-25s  %08X  %s\n",
+      (e.time - entries[0].time) / 1000.0, i > 0 ? (e.time - entries[i - 1].time) / 1000.0 : 0.0,
+      event, e.peer, ctlFlags(e.ctl, flags), e.key, statusText(e, status));
+    if (pcap) writePcap(node, e);
+    // key request sent (KEYREQ without KEY) to the key response received from the same node
+    if (e.event == TRACE_RX && e.status == TRACE_KEY)
+      for (int j = i - 1; j >= 0; j--)
+      {
+        const Entry& r = entries[j];
+        if (r.event == TRACE_TX && r.peer == e.peer && (r.ctl & (CTL_REQUEST | CTL_INCLUDED)) == CTL_REQUEST)
+        {
+          handshakes.push_back((e.time - r.time) / 1000.0);
+          break;
+        }
+      }
+  }
+  if (!handshakes.empty())
+  {
+    double sum = 0, low = handshakes[0], high = handshakes[0];
+    for (size_t i = 0; i < handshakes.size(); i++)
+    {
+      sum += handshakes[i];
+      if (handshakes[i] < low) low = handshakes[i];
+      if (handshakes[i] > high) high = handshakes[i];
+    }
+    printf("handshakes: %zu, latency (ms) min %.3f avg %.3f max %.3f\n", handshakes.size(), low, sum / handshakes.size(), high);
+  }
+  printf("\n");
+  return length;
+}
+
+static void usage()
+{
+  printf("usage: session-trace [--pcap file] capture\n"
+    "  capture      file holding the dumps of sessionTraceDump() (raw, or among text lines)\n"
+    "  --pcap file  also write the events to a pcap file (link type USER0)\n");
+}
+
+int main(int argc, char** argv)
+{
+  const char* capture = NULL;
+  const char* pcapName = NULL;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--pcap") && i + 1 < argc) pcapName = argv[++i];
+    else if (argv[i][0] != '-' && capture == NULL) capture = argv[i];
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+  if (capture == NULL)
+  {
+    usage();
+    return 1;
+  }
+  FILE* f = fopen(capture, "rb");
+  if (f == NULL)
+  {
+    perror(capture);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+  fclose(f);
+  if (pcapName)
+  {
+    pcap = fopen(pcapName, "wb");
+    if (pcap == NULL)
+    {
+      perror(pcapName);
+      return 1;
+    }
+    writePcapHeader();
+  }
+  int dumps = 0;
+  for (size_t i = 0; i + TRACE_HEADER <= data.size(); )
+  {
+    size_t length = 0;
+    if (data[i] == 'S' && data[i + 1] == 'T' && data[i + 2] == TRACE_FORMAT) length = decode(&data[i], data.size() - i);
+    if (length > 0) dumps++;
+    i += length > 0 ? length : 1;
+  }
+  if (pcap) fclose(pcap);
+  if (dumps == 0)
+  {
+    fprintf(stderr, "%s: no trace dump found\n", capture);
+    return 1;
+  }
+  return 0;
+}